@@ -22,21 +22,24 @@
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 
-#include <sys/wait.h>
-
 #include <netdb.h>
 #include <unistd.h>
 
-#include <sys/resource.h>
-
 #include <cassert>
 #include <cstdlib>
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <bitset>
 #include <chrono>
-#include <set>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "../ints/cmp.hpp"
 #include "../ints/udl.hpp"
@@ -49,9 +52,11 @@
 #include "../generic/array.hpp"
 
 #include "../io/cxxstdio.hpp"
+#include "../io/background.hpp"
 #include "../io/extract.hpp"
 #include "../io/lock.hpp"
 #include "../io/read.hpp"
+#include "../io/snapshot.hpp"
 #include "../io/tty.hpp"
 #include "../io/write.hpp"
 
@@ -70,6 +75,7 @@
 #include "../mmo/human_time_diff.hpp"
 #include "../mmo/version.hpp"
 
+#include "../high/char_delta.hpp"
 #include "../high/core.hpp"
 #include "../high/extract_mmo.hpp"
 #include "../high/mmo.hpp"
@@ -121,6 +127,7 @@ static
 int char_port = 6121;
 static
 AString char_txt;
+bool binary_snapshots = false;
 static
 CharName unknown_char_name = stringish<CharName>("Unknown"_s);
 static
@@ -174,8 +181,10 @@ int check_ip_flag = 1;         // It's to check IP of a player between char-serv
 
 static
 CharId char_id_count = wrap<CharId>(150000);
+// a list, so that CharPair pointers stay valid while others are added
+// and deleted; every change goes through char_insert/char_rekey/char_erase
 static
-std::vector<CharPair> char_keys;
+std::list<CharPair> char_keys;
 static
 int max_connect_user = 0;
 static
@@ -194,19 +203,72 @@ AString online_txt_filename = "online.txt"_s;
 static
 AString online_html_filename = "online.html"_s;
 static
+AString online_json_filename;  // empty for none
+static
 int online_sorting_option = 0; // sorting option to display online players in online files
 static
 int online_refresh_html = 20;  // refresh time (in sec) of the html file in the explorer
 static
 GmLevel online_gm_display_min_level = GmLevel::from(20_u32);  // minimum GM level to display 'GM' when we want to display it
 
+struct CharNameHash
+{
+    size_t operator()(const CharName& name) const
+    {
+        // FNV-1a, over the same form operator == compares
+        size_t h = 14695981039346656037ULL;
+        for (char c : name.to__canonical())
+        {
+            h ^= static_cast<uint8_t>(c);
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+};
+struct CharIdHash
+{
+    size_t operator()(CharId id) const
+    {
+        return std::hash<uint32_t>()(unwrap<CharId>(id));
+    }
+};
+struct AccountIdHash
+{
+    size_t operator()(AccountId id) const
+    {
+        return std::hash<uint32_t>()(unwrap<AccountId>(id));
+    }
+};
+static
+std::unordered_map<CharId, std::list<CharPair>::iterator, CharIdHash> char_by_id;
+static
+std::unordered_map<CharName, CharPair *, CharNameHash> char_by_name;
+// in char_keys order
+static
+std::unordered_map<AccountId, std::vector<CharPair *>, AccountIdHash> char_by_account;
+
+// map-server of every online character, by id
 static
-std::vector<Session *> online_chars;              // same size of char_keys, and id value of current server (or -1)
+std::unordered_map<CharId, Session *, CharIdHash> online_chars;
+// online_chars or GM levels changed since the online files were queued
 static
-TimeT update_online;           // to update online files when we receiving information from a server (not less than 8 seconds)
+bool online_dirty = true;
+// the online files are rewritten at most this often
+constexpr std::chrono::seconds ONLINE_FILES_INTERVAL = 8_s;
 
+// Every change to a character since char_txt was last written, in
+// order: a character line (replacing the character with that id) or
+// "id\t%delete%".  Written as the changes happen, synced to disk once
+// a second, replayed over char_txt at startup, and folded back into
+// char_txt by mmo_char_sync once it outgrows it.  While char_txt is
+// being rewritten, the journal it will replace waits as journal.old.
+static
+std::unique_ptr<io::AppendFile> char_journal;
+static
+size_t char_journal_records = 0;
 static
-pid_t pid = 0;                  // For forked DB writes
+bool char_journal_unsynced = false;
+constexpr size_t CHAR_JOURNAL_MIN = 1024;
 
 
 auto iter_map_sessions() -> decltype(filter_iterator<Session *>(std::declval<Array<Session *, MAX_MAP_SERVERS> *>()))
@@ -242,9 +304,14 @@ void delete_frommap(Session *sess)
             sess);
     server[id] = mmo_map_server{};
     server_session[id] = nullptr;
-    for (Session *& oci : online_chars)
-        if (oci == sess)
-            oci = nullptr;
+    for (auto oit = online_chars.begin(); oit != online_chars.end();)
+    {
+        if (oit->second == sess)
+            oit = online_chars.erase(oit);
+        else
+            ++oit;
+    }
+    online_dirty = true;
     create_online_files(); // update online players files (to remove all online players of this server)
 }
 
@@ -282,55 +349,169 @@ GmLevel isGM(AccountId account_id)
 //----------------------------------------------
 const CharPair *search_character(CharName character_name)
 {
-    for (const CharPair& cd : char_keys)
-    {
-        {
-            // Strict comparison (if found, we finish the function immediatly with correct value)
-            if (cd.key.name == character_name)
-                return &cd;
-        }
-    }
+    auto it = char_by_name.find(character_name);
+    if (it == char_by_name.end())
+        return nullptr;
+    return it->second;
+}
 
-    // Exact character name is not found and 0 or more than 1 similar characters have been found ==> we say not found
-    return nullptr;
+static
+CharPair *search_character_id_m(CharId char_id)
+{
+    auto it = char_by_id.find(char_id);
+    if (it == char_by_id.end())
+        return nullptr;
+    return &*it->second;
 }
 
 const CharPair *search_character_id(CharId char_id)
 {
-    for (const CharPair& cd : char_keys)
-    {
-        if (cd.key.char_id == char_id)
-            return &cd;
-    }
+    return search_character_id_m(char_id);
+}
 
-    return nullptr;
+// The characters of an account, copied so that the caller may delete them.
+static
+std::vector<CharPair *> account_chars(AccountId account_id)
+{
+    auto it = char_by_account.find(account_id);
+    if (it == char_by_account.end())
+        return {};
+    return it->second;
 }
 
-// TODO make these DIE already
 Session *server_for(const CharPair *mcs)
 {
     if (!mcs)
         return nullptr;
-    return online_chars[mcs - &char_keys.front()];
+    auto it = online_chars.find(mcs->key.char_id);
+    if (it == online_chars.end())
+        return nullptr;
+    return it->second;
 }
+
+//----------------------------------------------
+// Add, rename and delete characters
+//   (the only functions that change char_keys)
+//----------------------------------------------
 static
-Session *& server_for_m(const CharPair *mcs)
+CharPair *char_insert(CharPair cp)
 {
-    return online_chars[mcs - &char_keys.front()];
+    auto it = char_keys.insert(char_keys.end(), std::move(cp));
+    CharPair *c = &*it;
+    char_by_id.insert({c->key.char_id, it});
+    char_by_name.insert({c->key.name, c});
+    char_by_account[c->key.account_id].push_back(c);
+    return c;
+}
+
+static
+void char_unindex_account(CharPair *cp)
+{
+    auto it = char_by_account.find(cp->key.account_id);
+    if (it == char_by_account.end())
+        return;
+    std::vector<CharPair *>& chars = it->second;
+    chars.erase(std::remove(chars.begin(), chars.end(), cp), chars.end());
+    if (chars.empty())
+        char_by_account.erase(it);
+}
+
+static
+void char_unindex_name(CharPair *cp)
+{
+    auto it = char_by_name.find(cp->key.name);
+    if (it != char_by_name.end() && it->second == cp)
+        char_by_name.erase(it);
+}
+
+// The map-server sends the whole key back with every save.
+static
+void char_rekey(CharPair *cp, const CharKey& key)
+{
+    bool rename = cp->key.name.to__actual() != key.name.to__actual();
+    bool move = cp->key.account_id != key.account_id;
+    assert (cp->key.char_id == key.char_id);
+    if (rename)
+        char_unindex_name(cp);
+    if (move)
+        char_unindex_account(cp);
+    cp->key = key;
+    if (rename)
+        char_by_name.insert({cp->key.name, cp});
+    if (move)
+        char_by_account[cp->key.account_id].push_back(cp);
+}
+
+static
+void char_journal_delete(CharId char_id);
+
+static
+void char_erase(CharPair *cp)
+{
+    char_journal_delete(cp->key.char_id);
+    auto it = char_by_id.find(cp->key.char_id);
+    assert (it != char_by_id.end() && &*it->second == cp);
+    char_unindex_name(cp);
+    char_unindex_account(cp);
+    if (online_chars.erase(cp->key.char_id))
+        online_dirty = true;
+    char_keys.erase(it->second);
+    char_by_id.erase(it);
+}
+
+static
+AString char_journal_txt(void)
+{
+    return STRPRINTF("%s.journal"_fmt, char_txt);
+}
+
+static
+AString char_journal_old_txt(void)
+{
+    return STRPRINTF("%s.journal.old"_fmt, char_txt);
+}
+
+static
+AString mmo_char_tostr(const CharPair *cp);
+
+//----------------------------------------------
+// Record a change in the journal
+//   (nothing to do before the journal is opened,
+//   i.e. while the files are being read)
+//----------------------------------------------
+static
+void char_journal_put(CharPair *cp)
+{
+    if (!char_journal)
+        return;
+    char_journal->put_line(mmo_char_tostr(cp));
+    char_journal_records++;
+    char_journal_unsynced = true;
+}
+
+static
+void char_journal_delete(CharId char_id)
+{
+    if (!char_journal)
+        return;
+    FPRINTF(*char_journal, "%d\t%%delete%%\n"_fmt, char_id);
+    char_journal_records++;
+    char_journal_unsynced = true;
 }
 
 //-------------------------------------------------
 // Function to create the character line (for save)
 //-------------------------------------------------
 static
-AString mmo_char_tostr(struct CharPair *cp)
+AString mmo_char_tostr(const CharPair *cp)
 {
-    CharKey *k = &cp->key;
-    CharData *p = cp->data.get();
+    const CharKey *k = &cp->key;
+    const CharData *p = cp->data.get();
     // on multi-map server, sometimes it's posssible that last_point become void. (reason???) We check that to not lost character at restart.
-    if (!p->last_point.map_)
+    Point last_point = p->last_point;
+    if (!last_point.map_)
     {
-        p->last_point = start_point;
+        last_point = start_point;
     }
 
     MString str_p;
@@ -361,7 +542,7 @@ AString mmo_char_tostr(struct CharPair *cp)
             p->party_id, 0/*guild_id*/, 0/*pet_id*/,
             p->hair, p->hair_color, p->clothes_color,
             p->weapon, p->shield, p->head_top, p->head_mid, p->head_bottom,
-            p->last_point.map_, p->last_point.x, p->last_point.y,
+            last_point.map_, last_point.x, last_point.y,
             p->save_point.map_, p->save_point.x, p->save_point.y, p->partner_id);
 
     // memos were here (no longer supported)
@@ -449,7 +630,7 @@ static
 bool extract(XString str, CharPair *cp)
 {
     CharKey *k = &cp->key;
-    CharData *p = cp->data.get();
+    CharData *p = &cp->mut();
 
     uint32_t unused_guild_id, unused_pet_id;
     XString unused_memos;
@@ -495,20 +676,7 @@ bool extract(XString str, CharPair *cp)
     if (wisp_server_name == k->name)
         return false;
 
-    // TODO replace *every* lookup with a map lookup
-    static std::set<CharId> seen_ids;
-    static std::set<CharName> seen_names;
-    // we don't have to worry about deleted characters,
-    // this is only called during startup
-    auto _seen_id = seen_ids.insert(k->char_id);
-    if (!_seen_id.second)
-        return false;
-    auto _seen_name = seen_names.insert(k->name);
-    if (!_seen_name.second)
-    {
-        seen_ids.erase(_seen_id.first);
-        return false;
-    }
+    // duplicate ids and names are checked by the caller
 
     // memos were here - no longer supported
 
@@ -535,26 +703,109 @@ bool extract(XString str, CharPair *cp)
     return true;
 }
 
+// A character in a binary snapshot of char_txt.
+struct NetCharRecord
+{
+    NetCharKey key;
+    NetCharData data;
+};
+static_assert(alignof(NetCharRecord) == 1, "alignof(NetCharRecord) == 1");
+constexpr uint32_t CHAR_SNAPSHOT_KIND = io::snapshot_kind("CHAR");
+constexpr uint32_t CHAR_SNAPSHOT_VERSION = 1;
+
 //---------------------------------
-// Function to read characters file
+// Add a character read from a file
+//   (returns false if its id or name is taken;
+//   in the journal, the same id replaces the old one)
 //---------------------------------
 static
-int mmo_char_init(void)
+bool mmo_char_load(CharPair&& cd, bool journal)
 {
-    char_keys.clear();
-    online_chars.clear();
+    CharPair *cp = search_character_id_m(cd.key.char_id);
+    const CharPair *named = search_character(cd.key.name);
+    bool taken = named && named != cp
+        && named->key.name.to__actual() == cd.key.name.to__actual();
+    if ((cp && !journal) || taken)
+        return false;
+    if (char_id_count < next(cd.key.char_id))
+        char_id_count = next(cd.key.char_id);
+    if (cp)
+    {
+        char_rekey(cp, cd.key);
+        cp->data = std::move(cd.data);
+    }
+    else
+        char_insert(std::move(cd));
+    return true;
+}
 
-    io::ReadFile in(char_txt);
-    if (!in.is_open())
+static
+void mmo_char_read_snapshot(io::SnapshotReader& snap)
+{
+    if (!snap.check(CHAR_SNAPSHOT_KIND, CHAR_SNAPSHOT_VERSION, sizeof(NetCharRecord)))
     {
-        PRINTF("Characters file not found: %s.\n"_fmt, char_txt);
-        CHAR_LOG("Characters file not found: %s.\n"_fmt, char_txt);
-        CHAR_LOG("Id for the next created character: %d.\n"_fmt,
-                char_id_count);
-        return 0;
+        PRINTF("Characters file is damaged: %s.\n"_fmt, char_txt);
+        CHAR_LOG("Characters file is damaged: %s.\n"_fmt, char_txt);
+        exit(1);
+    }
+    CharId next_id = wrap<CharId>(static_cast<uint32_t>(snap.next_id()));
+    if (char_id_count < next_id)
+        char_id_count = next_id;
+    for (size_t i = 0, n = snap.size(); i < n; ++i)
+    {
+        const NetCharRecord& rec = snap.get<NetCharRecord>(i);
+        CharPair cd;
+        if (!network_to_native(&cd.key, rec.key)
+            || !network_to_native(&cd.mut(), rec.data)
+            || !mmo_char_load(std::move(cd), false))
+            CHAR_LOG("Char skipped (record %zu of %s)\n"_fmt, i, char_txt);
+    }
+}
+
+// The characters as they were at one moment, for writing char_txt off
+// the main thread.  The CharData is shared with char_keys (see
+// CharPair::mut()); CharKey and the rest are copies.
+struct CharSnapshot
+{
+    AString filename;
+    bool binary;
+    CharId next_id;
+    std::vector<CharPair> chars;
+
+    // filled in by mmo_char_write
+    bool written = false;
+    std::vector<CharId> not_saved;
+    std::chrono::steady_clock::duration copy_time, write_time;
+};
+
+static
+void mmo_char_write_snapshot(io::WriteFile& fp, CharSnapshot& cs)
+{
+    io::SnapshotWriter snap(fp, CHAR_SNAPSHOT_KIND, CHAR_SNAPSHOT_VERSION,
+            sizeof(NetCharRecord), unwrap<CharId>(cs.next_id));
+    for (CharPair& cd : cs.chars)
+    {
+        NetCharRecord rec;
+        if (!native_to_network(&rec.key, cd.key)
+            || !native_to_network(&rec.data, *cd.data))
+        {
+            cs.not_saved.push_back(cd.key.char_id);
+            continue;
+        }
+        snap.put(rec);
     }
+}
 
-    int line_count = 0;
+//---------------------------------
+// Function to read characters file
+//   (also reads the journal, where a character line
+//   replaces any earlier one with the same id)
+//   Returns the number of lines read.
+//---------------------------------
+static
+size_t mmo_char_read(io::ReadFile& in, bool journal)
+{
+    size_t line_count = 0;
     AString line;
     while (in.getline(line))
     {
@@ -571,6 +822,12 @@ int mmo_char_init(void)
                     char_id_count = i;
                 continue;
             }
+            if (extract(line, record<'\t'>(&i, "%delete%"_s)))
+            {
+                if (CharPair *cp = search_character_id_m(i))
+                    char_erase(cp);
+                continue;
+            }
         }
 
         CharPair cd;
@@ -579,10 +836,60 @@ int mmo_char_init(void)
             CHAR_LOG("Char skipped\n%s"_fmt, line);
             continue;
         }
-        if (char_id_count < next(cd.key.char_id))
-            char_id_count = next(cd.key.char_id);
-        char_keys.push_back(std::move(cd));
-        online_chars.push_back(nullptr);
+        if (!mmo_char_load(std::move(cd), journal))
+            CHAR_LOG("Char skipped (duplicate id or name)\n%s"_fmt, line);
+    }
+    return line_count;
+}
+
+static
+int mmo_char_init(void)
+{
+    char_keys.clear();
+    char_by_id.clear();
+    char_by_name.clear();
+    char_by_account.clear();
+    online_chars.clear();
+
+    {
+        io::SnapshotReader snap(char_txt);
+        if (snap.is_snapshot())
+            mmo_char_read_snapshot(snap);
+        else
+        {
+            io::ReadFile in(char_txt);
+            if (!in.is_open())
+            {
+                PRINTF("Characters file not found: %s.\n"_fmt, char_txt);
+                CHAR_LOG("Characters file not found: %s.\n"_fmt, char_txt);
+            }
+            else
+                mmo_char_read(in, false);
+        }
+    }
+
+    // journal.old is only there if char_txt was not rewritten after it
+    char_journal_records = 0;
+    for (AString journal : {char_journal_old_txt(), char_journal_txt()})
+    {
+        io::ReadFile in(journal);
+        if (in.is_open())
+        {
+            size_t records = mmo_char_read(in, true);
+            char_journal_records += records;
+            PRINTF("mmo_char_init: %zu changes replayed from %s.\n"_fmt,
+                    records, journal);
+            CHAR_LOG("mmo_char_init: %zu changes replayed from %s.\n"_fmt,
+                    records, journal);
+        }
+    }
+    AString journal = char_journal_txt();
+    char_journal = make_unique<io::AppendFile>(journal);
+    if (!char_journal->is_open())
+    {
+        PRINTF("WARNING: can't open %s, every save will rewrite %s.\n"_fmt,
+                journal, char_txt);
+        CHAR_LOG("WARNING: can't open %s.\n"_fmt, journal);
     }
 
     PRINTF("mmo_char_init: %zu characters read in %s.\n"_fmt,
@@ -597,63 +904,243 @@ int mmo_char_init(void)
 }
 
 //---------------------------------------------------------
-// Function to save characters in files (speed up by [Yor])
+// Read every database at startup.
+//   The inter-server files are parsed by loader threads while
+//   the main thread reads the characters; inter_init2() then
+//   loads what they parsed, in the same order as before, and
+//   checks the parties against the characters.
 //---------------------------------------------------------
 static
-void mmo_char_sync(void)
+void char_load_all(void)
 {
-    io::WriteLock fp(char_txt);
-    if (!fp.is_open())
+    namespace c = std::chrono;
+    auto as_ms = [](c::steady_clock::duration d)
     {
-        PRINTF("WARNING: Server can't not save characters.\n"_fmt);
-        CHAR_LOG("WARNING: Server can't not save characters.\n"_fmt);
-        return;
-    }
+        return c::duration_cast<c::milliseconds>(d).count();
+    };
+
+    std::vector<LoadJob> jobs;
+    inter_init_jobs(jobs);
+
+    std::atomic<size_t> next_job(0);
+    auto load_worker = [&]()
     {
-        // yes, we need a mutable reference to do the saves ...
-        for (CharPair& cd : char_keys)
+        size_t i;
+        while ((i = next_job++) < jobs.size())
         {
-            AString line = mmo_char_tostr(&cd);
-            fp.put_line(line);
+            auto start = c::steady_clock::now();
+            jobs[i].read();
+            jobs[i].elapsed = c::steady_clock::now() - start;
         }
-        FPRINTF(fp, "%d\t%%newid%%\n"_fmt, char_id_count);
+    };
+    size_t nthreads = std::min<size_t>(jobs.size(),
+            std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < nthreads; i++)
+        workers.emplace_back(load_worker);
+
+    auto start = c::steady_clock::now();
+    mmo_char_init();
+    auto char_time = c::steady_clock::now() - start;
+    for (std::thread& t : workers)
+        t.join();
+    auto merge_start = c::steady_clock::now();
+    inter_init2();
+    auto end = c::steady_clock::now();
+
+    // the time each store took to parse, added up over its files
+    std::vector<LoadJob> stores;
+    for (LoadJob& job : jobs)
+    {
+        auto it = std::find_if(stores.begin(), stores.end(),
+                [&job](const LoadJob& s) { return s.store == job.store; });
+        if (it == stores.end())
+            stores.push_back(LoadJob{job.store, nullptr, job.elapsed});
+        else
+            it->elapsed += job.elapsed;
     }
+    CHAR_LOG("char_load_all: characters %ld ms.\n"_fmt, as_ms(char_time));
+    for (LoadJob& store : stores)
+        CHAR_LOG("char_load_all: %s %ld ms.\n"_fmt, store.store, as_ms(store.elapsed));
+    PRINTF("char_load_all: databases read in %ld ms by %zu threads, then loaded in %ld ms.\n"_fmt,
+            as_ms(merge_start - start), nthreads + 1, as_ms(end - merge_start));
+    CHAR_LOG("char_load_all: databases read in %ld ms by %zu threads, then loaded in %ld ms.\n"_fmt,
+            as_ms(merge_start - start), nthreads + 1, as_ms(end - merge_start));
 }
 
-//----------------------------------------------------
-// Function to save (in a periodic way) datas in files
-//----------------------------------------------------
+//---------------------------------------------------------
+// Function to save characters in files (speed up by [Yor])
+//   The characters are copied on the main thread and written
+//   by char_sync_worker (or at once, by mmo_char_sync).
+//---------------------------------------------------------
 static
-void mmo_char_sync_timer(TimerData *, tick_t)
+io::Background char_sync_worker;
+// the snapshot char_sync_worker is writing
+static
+std::unique_ptr<CharSnapshot> char_sync_job;
+
+static
+std::unique_ptr<CharSnapshot> mmo_char_snapshot(void)
 {
-    if (pid != 0)
+    auto start = std::chrono::steady_clock::now();
+    auto cs = make_unique<CharSnapshot>();
+    cs->filename = AString(char_txt.begin(), char_txt.end());
+    cs->binary = binary_snapshots;
+    cs->next_id = char_id_count;
+    cs->chars.reserve(char_keys.size());
+    // only the pointers are copied; CharPair::mut() copies a
+    // character if it changes before the write is done
+    for (const CharPair& cd : char_keys)
+        cs->chars.push_back(cd);
+    cs->copy_time = std::chrono::steady_clock::now() - start;
+    return cs;
+}
+
+// Runs on either thread; touches nothing but cs.
+static
+void mmo_char_write(CharSnapshot& cs)
+{
+    auto start = std::chrono::steady_clock::now();
     {
-        int status;
-        pid_t temp = waitpid(pid, &status, WNOHANG);
+        io::WriteLock fp(cs.filename);
+        if (!fp.is_open())
+            return;
+        if (cs.binary)
+            mmo_char_write_snapshot(fp, cs);
+        else
+        {
+            // yes, we need a mutable reference to do the saves ...
+            for (CharPair& cd : cs.chars)
+            {
+                AString line = mmo_char_tostr(&cd);
+                fp.put_line(line);
+            }
+            FPRINTF(fp, "%d\t%%newid%%\n"_fmt, cs.next_id);
+        }
+    }
+    cs.written = true;
+    cs.write_time = std::chrono::steady_clock::now() - start;
+}
 
-        // Need to check status too?
-        if (temp == 0)
+//---------------------------------------------------------
+// Start a new journal; what was in the old one is in the
+// snapshot being taken, and is dropped once that is written.
+//---------------------------------------------------------
+static
+void char_journal_seal(void)
+{
+    if (!char_journal)
+        return;
+    AString journal = char_journal_txt();
+    AString old = char_journal_old_txt();
+    char_journal.reset();
+    if (link(journal.c_str(), old.c_str()) != 0)
+    {
+        // the last snapshot failed, so the older changes are still needed
+        io::ReadFile in(journal);
+        io::AppendFile out(old);
+        AString line;
+        if (in.is_open() && out.is_open())
         {
-            return;
+            while (in.getline(line))
+                out.put_line(line);
+            if (!out.sync())
+                CHAR_LOG("WARNING: can't write %s.\n"_fmt, old);
         }
     }
+    unlink(journal.c_str());
+    char_journal = make_unique<io::AppendFile>(journal);
+    char_journal_records = 0;
+    char_journal_unsynced = false;
+}
 
-    // This can take a lot of time. Fork a child to handle the work and return at once
-    // If we're unable to fork just continue running the function normally
-    if ((pid = fork()) > 0) {
+// Back on the main thread, after mmo_char_write.
+static
+void mmo_char_sync_finish(CharSnapshot& cs)
+{
+    namespace c = std::chrono;
+    if (!cs.written)
+    {
+        PRINTF("WARNING: Server can't not save characters.\n"_fmt);
+        CHAR_LOG("WARNING: Server can't not save characters.\n"_fmt);
         return;
     }
+    for (CharId char_id : cs.not_saved)
+        CHAR_LOG("Char not saved: %d\n"_fmt, char_id);
+    // char_txt now has everything the old journal had
+    unlink(char_journal_old_txt().c_str());
+    CHAR_LOG("mmo_char_sync: %zu characters, %ld ms to copy, %ld ms to write.\n"_fmt,
+            cs.chars.size(),
+            c::duration_cast<c::milliseconds>(cs.copy_time).count(),
+            c::duration_cast<c::milliseconds>(cs.write_time).count());
+}
 
-    // If we're a child, run as a lower priority process
-    if (pid == 0)
-        setpriority(PRIO_PROCESS, getpid(), 10);
+static
+void mmo_char_sync_poll(void)
+{
+    if (char_sync_job && char_sync_worker.done())
+    {
+        mmo_char_sync_finish(*char_sync_job);
+        char_sync_job.reset();
+    }
+}
 
-    mmo_char_sync();
+/// Write char_txt now, after any write still running.
+static
+void mmo_char_sync(void)
+{
+    char_sync_worker.wait();
+    mmo_char_sync_poll();
+
+    std::unique_ptr<CharSnapshot> cs = mmo_char_snapshot();
+    char_journal_seal();
+    mmo_char_write(*cs);
+    mmo_char_sync_finish(*cs);
+}
+
+static
+void mmo_char_sync_start(void)
+{
+    mmo_char_sync_poll();
+    if (char_sync_job)
+        return;
+
+    char_sync_job = mmo_char_snapshot();
+    char_journal_seal();
+    CharSnapshot *cs = char_sync_job.get();
+    if (!char_sync_worker.start([cs]() { mmo_char_write(*cs); }))
+        abort();
+}
+
+//----------------------------------------------------
+// Function to save (in a periodic way) datas in files
+//   Characters are already in the journal; char_txt is
+//   only rewritten once the journal is bigger than it.
+//----------------------------------------------------
+static
+void mmo_char_sync_timer(TimerData *, tick_t)
+{
+    if (!char_journal->is_open())
+        mmo_char_sync();
+    else if (char_journal_records > std::max(char_keys.size(), CHAR_JOURNAL_MIN))
+        mmo_char_sync_start();
     inter_save();
+}
 
-    // If we're a child we should suicide now.
-    if (pid == 0)
-        _exit(0);
+static
+void char_journal_sync_timer(TimerData *, tick_t)
+{
+    mmo_char_sync_poll();
+    if (!char_journal_unsynced)
+        return;
+    char_journal_unsynced = false;
+    if (!char_journal->sync())
+    {
+        PRINTF("WARNING: can't write %s, saving %s instead.\n"_fmt,
+                char_journal_txt(), char_txt);
+        CHAR_LOG("WARNING: can't write %s.\n"_fmt, char_journal_txt());
+        mmo_char_sync();
+    }
 }
 
 //-----------------------------------
@@ -743,22 +1230,21 @@ CharPair *make_new_char(Session *s, CharName name, const Stats6& stats, uint8_t
         }
     }
 
-    for (const CharPair& cd : char_keys)
+    if (const CharPair *cd = search_character(name))
     {
-        if (cd.key.name == name)
-        {
-            CHAR_LOG("Make new char error (name already exists): (connection #%d, account: %d) slot %d, name: %s (actual name of other char: %s), stats: %d+%d+%d+%d+%d+%d=%d, hair: %d, hair color: %d.\n"_fmt,
-                    s, sd->account_id, slot, name, cd.key.name,
-                    stats.str, stats.agi, stats.vit, stats.int_, stats.dex, stats.luk,
-                    stats.str + stats.agi + stats.vit + stats.int_ + stats.dex + stats.luk,
-                    hair_style, hair_color);
-            return nullptr;
-        }
-        if (cd.key.account_id == sd->account_id
-            && cd.key.char_num == slot)
+        CHAR_LOG("Make new char error (name already exists): (connection #%d, account: %d) slot %d, name: %s (actual name of other char: %s), stats: %d+%d+%d+%d+%d+%d=%d, hair: %d, hair color: %d.\n"_fmt,
+                s, sd->account_id, slot, name, cd->key.name,
+                stats.str, stats.agi, stats.vit, stats.int_, stats.dex, stats.luk,
+                stats.str + stats.agi + stats.vit + stats.int_ + stats.dex + stats.luk,
+                hair_style, hair_color);
+        return nullptr;
+    }
+    for (const CharPair *cd : account_chars(sd->account_id))
+    {
+        if (cd->key.char_num == slot)
         {
             CHAR_LOG("Make new char error (slot already used): (connection #%d, account: %d) slot %d, name: %s (actual name of other char: %s), stats: %d+%d+%d+%d+%d+%d=%d, hair: %d, hair color: %d.\n"_fmt,
-                    s, sd->account_id, slot, name, cd.key.name,
+                    s, sd->account_id, slot, name, cd->key.name,
                     stats.str, stats.agi, stats.vit, stats.int_, stats.dex, stats.luk,
                     stats.str + stats.agi + stats.vit + stats.int_ + stats.dex + stats.luk,
                     hair_style, hair_color);
@@ -786,7 +1272,7 @@ CharPair *make_new_char(Session *s, CharName name, const Stats6& stats, uint8_t
 
     CharPair cp;
     CharKey& ck = cp.key;
-    CharData& cd = *cp.data;
+    CharData& cd = cp.mut();
 
     ck.char_id = char_id_count; char_id_count = next(char_id_count);
     ck.account_id = sd->account_id;
@@ -826,39 +1312,107 @@ CharPair *make_new_char(Session *s, CharName name, const Stats6& stats, uint8_t
     cd.head_bottom = ItemNameId();
     cd.last_point = start_point;
     cd.save_point = start_point;
-    char_keys.push_back(std::move(cp));
-    online_chars.push_back(nullptr);
 
-    return &char_keys.back();
+    CharPair *c = char_insert(std::move(cp));
+    char_journal_put(c);
+    return c;
 }
 
 //-------------------------------------------------------------
 // Function to create the online files (txt and html). by [Yor]
+// The list of players is taken on the main thread; the files are
+// written by online_writer, so only the latest list is ever waiting.
 //-------------------------------------------------------------
+struct OnlinePlayer
+{
+    CharName name;
+    bool gm;
+};
+// Everything the writer needs, with no strings shared with the main
+// thread (AString counts its references without atomics).
+struct OnlineFiles
+{
+    AString txt_filename, html_filename, json_filename;
+    AString server_name;
+    int refresh_html;
+    timestamp_seconds_buffer timetemp;
+    std::vector<OnlinePlayer> players;
+};
+
 static
-void create_online_files(void)
+std::thread online_writer;
+static
+std::mutex online_lock;
+static
+std::condition_variable online_wake;
+static
+std::unique_ptr<OnlineFiles> online_pending;
+static
+bool online_quit;
+
+static
+AString own_copy(XString s)
+{
+    return AString(s.begin(), s.end());
+}
+
+static
+void write_online_json(const OnlineFiles& job)
+{
+    io::WriteFile fp(job.json_filename);
+    if (!fp.is_open())
+        return;
+    auto json_string = [&fp](XString str)
+    {
+        FPRINTF(fp, "\""_fmt);
+        for (char c : str)
+        {
+            if (c == '"' || c == '\\')
+                FPRINTF(fp, "\\%c"_fmt, c);
+            else if (static_cast<unsigned char>(c) < 0x20)
+                FPRINTF(fp, "\\u%04x"_fmt, c);
+            else
+                FPRINTF(fp, "%c"_fmt, c);
+        }
+        FPRINTF(fp, "\""_fmt);
+    };
+    FPRINTF(fp, "{\"server\":"_fmt);
+    json_string(job.server_name);
+    FPRINTF(fp, ",\"time\":"_fmt);
+    json_string(job.timetemp);
+    FPRINTF(fp, ",\"count\":%zu,\"players\":["_fmt, job.players.size());
+    bool first = true;
+    for (const OnlinePlayer& op : job.players)
+    {
+        FPRINTF(fp, "%s{\"name\":"_fmt, first ? ""_s : ","_s);
+        json_string(op.name.to__actual());
+        FPRINTF(fp, ",\"gm\":%s}"_fmt, op.gm ? "true"_s : "false"_s);
+        first = false;
+    }
+    FPRINTF(fp, "]}\n"_fmt);
+}
+
+static
+void write_online_files(const OnlineFiles& job)
 {
     // write files
-    io::WriteFile fp(online_txt_filename);
+    io::WriteFile fp(job.txt_filename);
     if (fp.is_open())
     {
-        io::WriteFile fp2(online_html_filename);
+        io::WriteFile fp2(job.html_filename);
         if (fp2.is_open())
         {
-            // get time
-            timestamp_seconds_buffer timetemp;
-            stamp_time(timetemp);
             // write heading
             FPRINTF(fp2, "<HTML>\n"_fmt);
-            FPRINTF(fp2, "  <META http-equiv=\"Refresh\" content=\"%d\">\n"_fmt, online_refresh_html); // update on client explorer every x seconds
+            FPRINTF(fp2, "  <META http-equiv=\"Refresh\" content=\"%d\">\n"_fmt, job.refresh_html); // update on client explorer every x seconds
             FPRINTF(fp2, "  <HEAD>\n"_fmt);
             FPRINTF(fp2, "    <TITLE>Online Players on %s</TITLE>\n"_fmt,
-                    server_name);
+                    job.server_name);
             FPRINTF(fp2, "  </HEAD>\n"_fmt);
             FPRINTF(fp2, "  <BODY>\n"_fmt);
             FPRINTF(fp2, "    <H3>Online Players on %s (%s):</H3>\n"_fmt,
-                    server_name, timetemp);
-            FPRINTF(fp, "Online Players on %s (%s):\n"_fmt, server_name, timetemp);
+                    job.server_name, job.timetemp);
+            FPRINTF(fp, "Online Players on %s (%s):\n"_fmt, job.server_name, job.timetemp);
             FPRINTF(fp, "\n"_fmt);
 
             int players = 0;
@@ -883,27 +1437,24 @@ void create_online_files(void)
                 FPRINTF(fp, "\n"_fmt);
 
                 // display each player.
-                for (CharPair& cd : char_keys)
+                for (const OnlinePlayer& op : job.players)
                 {
-                    if (!server_for(&cd))
-                        continue;
                     players++;
                     FPRINTF(fp2, "      <tr>\n"_fmt);
                     // displaying the character name
                     {
                         // without/with 'GM' display
-                        GmLevel gml = isGM(cd.key.account_id);
                         {
-                            if (gml.satisfies(online_gm_display_min_level))
-                                FPRINTF(fp, "%-24s (GM) "_fmt, cd.key.name);
+                            if (op.gm)
+                                FPRINTF(fp, "%-24s (GM) "_fmt, op.name);
                             else
-                                FPRINTF(fp, "%-24s      "_fmt, cd.key.name);
+                                FPRINTF(fp, "%-24s      "_fmt, op.name);
                         }
                         // name of the character in the html (no < >, because that create problem in html code)
                         FPRINTF(fp2, "        <td>"_fmt);
-                        if (gml.satisfies(online_gm_display_min_level))
+                        if (op.gm)
                             FPRINTF(fp2, "<b>"_fmt);
-                        for (char c : cd.key.name.to__actual())
+                        for (char c : op.name.to__actual())
                         {
                             switch (c)
                             {
@@ -921,7 +1472,7 @@ void create_online_files(void)
                                 break;
                             };
                         }
-                        if (gml.satisfies(online_gm_display_min_level))
+                        if (op.gm)
                             FPRINTF(fp2, "</b> (GM)"_fmt);
                         FPRINTF(fp2, "</td>\n"_fmt);
                     }
@@ -952,7 +1503,96 @@ void create_online_files(void)
         }
     }
 
-    return;
+    if (job.json_filename)
+        write_online_json(job);
+}
+
+
+static
+void online_writer_main(void)
+{
+    std::unique_lock<std::mutex> guard(online_lock);
+    while (true)
+    {
+        online_wake.wait(guard, []{ return online_pending || online_quit; });
+        if (!online_pending)
+            return;
+        std::unique_ptr<OnlineFiles> job = std::move(online_pending);
+        guard.unlock();
+        write_online_files(*job);
+        guard.lock();
+    }
+}
+
+static
+std::unique_ptr<OnlineFiles> take_online_list(void)
+{
+    auto job = make_unique<OnlineFiles>();
+    job->txt_filename = own_copy(online_txt_filename);
+    job->html_filename = own_copy(online_html_filename);
+    job->json_filename = own_copy(online_json_filename);
+    job->server_name = own_copy(server_name);
+    job->refresh_html = online_refresh_html;
+    stamp_time(job->timetemp);
+    std::vector<const CharPair *> online;
+    online.reserve(online_chars.size());
+    for (const auto& pair : online_chars)
+        online.push_back(&*char_by_id.find(pair.first)->second);
+    if (online_sorting_option)
+        std::sort(online.begin(), online.end(),
+                [](const CharPair *l, const CharPair *r)
+                {
+                    return l->key.name < r->key.name;
+                });
+    else
+        std::sort(online.begin(), online.end(),
+                [](const CharPair *l, const CharPair *r)
+                {
+                    return l->key.char_id < r->key.char_id;
+                });
+    job->players.reserve(online.size());
+    for (const CharPair *cp : online)
+        job->players.push_back(OnlinePlayer{cp->key.name,
+                isGM(cp->key.account_id).satisfies(online_gm_display_min_level)});
+    return job;
+}
+
+/// Queue the files for the writer, if anything changed.
+static
+void create_online_files(void)
+{
+    if (!online_dirty)
+        return;
+    online_dirty = false;
+    std::unique_ptr<OnlineFiles> job = take_online_list();
+    if (!online_writer.joinable())
+    {
+        write_online_files(*job);
+        return;
+    }
+    std::lock_guard<std::mutex> guard(online_lock);
+    online_pending = std::move(job);
+    online_wake.notify_one();
+}
+
+static
+void create_online_files_timer(TimerData *, tick_t)
+{
+    create_online_files();
+}
+
+/// Stop the writer after it has written what is queued.
+static
+void online_writer_stop(void)
+{
+    if (!online_writer.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> guard(online_lock);
+        online_quit = true;
+        online_wake.notify_one();
+    }
+    online_writer.join();
 }
 
 //---------------------------------------------------------------------
@@ -977,7 +1617,7 @@ int count_users(void)
 static
 ItemNameId find_equip_view(const CharPair *cp, EPOS equipmask)
 {
-    CharData *p = cp->data.get();
+    const CharData *p = cp->data.get();
     for (IOff0 i : IOff0::iter())
     {
         if (p->inventory[i].nameid && p->inventory[i].amount
@@ -997,15 +1637,12 @@ int mmo_char_send006b(Session *s, struct char_session_data *sd)
 {
     int found_num = 0;
     std::array<const CharPair *, 9> found_char;
-    for (const CharPair& cd : char_keys)
+    for (const CharPair *cd : account_chars(sd->account_id))
     {
-        if (cd.key.account_id == sd->account_id)
-        {
-            found_char[found_num] = &cd;
-            found_num++;
-            if (found_num == 9)
-                break;
-        }
+        found_char[found_num] = cd;
+        found_num++;
+        if (found_num == 9)
+            break;
     }
 
     Packet_Head<0x006b> head_6b;
@@ -1081,17 +1718,16 @@ int set_account_reg2(AccountId acc, Slice<GlobalReg> reg)
     size_t num = reg.size();
     assert (num < ACCOUNT_REG2_NUM);
     int c = 0;
-    for (CharPair& cd : char_keys)
+    for (CharPair *cd : account_chars(acc))
     {
-        if (cd.key.account_id == acc)
-        {
-            for (int i = 0; i < num; ++i)
-                cd.data->account_reg2[i] = reg[i];
-            cd.data->account_reg2_num = num;
-            for (int i = num; i < ACCOUNT_REG2_NUM; ++i)
-                cd.data->account_reg2[i] = GlobalReg{};
-            c++;
-        }
+        CharData& data = cd->mut();
+        for (int i = 0; i < num; ++i)
+            data.account_reg2[i] = reg[i];
+        data.account_reg2_num = num;
+        for (int i = num; i < ACCOUNT_REG2_NUM; ++i)
+            data.account_reg2[i] = GlobalReg{};
+        char_journal_put(cd);
+        c++;
     }
     return c;
 }
@@ -1104,7 +1740,7 @@ int char_divorce(CharPair *cp)
         return 0;
 
     CharKey *ck = &cp->key;
-    CharData *cs = cp->data.get();
+    const CharData *cs = cp->data.get();
 
     if (!cs->partner_id)
     {
@@ -1122,39 +1758,30 @@ int char_divorce(CharPair *cp)
     Packet_Fixed<0x2b12> fixed_12;
     fixed_12.char_id = ck->char_id;
 
-    for (CharPair& cd : char_keys)
+    if (CharPair *partner = search_character_id_m(cs->partner_id))
     {
-        if (cd.key.char_id == cs->partner_id
-            && cd.data->partner_id == ck->char_id)
+        fixed_12.partner_id = cs->partner_id;
+        for (Session *ss : iter_map_sessions())
         {
-            fixed_12.partner_id = cs->partner_id;
-            for (Session *ss : iter_map_sessions())
-            {
-                send_fpacket<0x2b12, 10>(ss, fixed_12);
-            }
-
-            cs->partner_id = CharId();
-            cd.data->partner_id = CharId();
-            return 0;
+            send_fpacket<0x2b12, 10>(ss, fixed_12);
         }
-        // The other char doesn't have us as their partner, so just clear our partner
+
+        // If the other char doesn't have us as their partner, just clear our partner
         // Don't worry about this, as the map server should verify itself that the other doesn't have us as a partner, and so won't mess with their marriage
-        else if (cd.key.char_id == cs->partner_id)
+        if (partner->data->partner_id == ck->char_id)
         {
-            fixed_12.partner_id = cs->partner_id;
-            for (Session *ss : iter_map_sessions())
-            {
-                send_fpacket<0x2b12, 10>(ss, fixed_12);
-            }
-
-            cs->partner_id = CharId();
-            return 0;
+            partner->mut().partner_id = CharId();
+            char_journal_put(partner);
         }
+        cp->mut().partner_id = CharId();
+        char_journal_put(cp);
+        return 0;
     }
 
     // Our partner wasn't found, so just clear our marriage
     fixed_12.partner_id = cs->partner_id;
-    cs->partner_id = CharId();
+    cp->mut().partner_id = CharId();
+    char_journal_put(cp);
     for (Session *ss : iter_map_sessions())
     {
         send_fpacket<0x2b12, 10>(ss, fixed_12);
@@ -1192,7 +1819,7 @@ static
 int char_delete(CharPair *cp)
 {
     CharKey *ck = &cp->key;
-    CharData *cs = cp->data.get();
+    const CharData *cs = cp->data.get();
 
     // パーティー脱退
     if (cs->party_id)
@@ -1368,27 +1995,24 @@ void parse_tologin(Session *ls)
                     SEX sex = fixed.sex;
                     if (acc)
                     {
-                        for (CharPair& cp : char_keys)
+                        for (CharPair *cp : account_chars(acc))
                         {
-                            CharKey& ck = cp.key;
-                            CharData& cd = *cp.data;
-                            if (ck.account_id == acc)
-                            {
-                                cd.sex = sex;
+                            CharData& cd = cp->mut();
+                            cd.sex = sex;
 //                      auth_fifo[i].sex = sex;
-                                // to avoid any problem with equipment and invalid sex, equipment is unequiped.
-                                for (IOff0 j : IOff0::iter())
-                                {
-                                    if (cd.inventory[j].nameid
-                                        && bool(cd.inventory[j].equip))
-                                        cd.inventory[j].equip = EPOS::ZERO;
-                                }
-                                cd.weapon = ItemLook::NONE;
-                                cd.shield = ItemNameId();
-                                cd.head_top = ItemNameId();
-                                cd.head_mid = ItemNameId();
-                                cd.head_bottom = ItemNameId();
+                            // to avoid any problem with equipment and invalid sex, equipment is unequiped.
+                            for (IOff0 j : IOff0::iter())
+                            {
+                                if (cd.inventory[j].nameid
+                                    && bool(cd.inventory[j].equip))
+                                    cd.inventory[j].equip = EPOS::ZERO;
                             }
+                            cd.weapon = ItemLook::NONE;
+                            cd.shield = ItemNameId();
+                            cd.head_top = ItemNameId();
+                            cd.head_mid = ItemNameId();
+                            cd.head_bottom = ItemNameId();
+                            char_journal_put(cp);
                         }
                         // disconnect player if online on char-server
                         disconnect_player(acc);
@@ -1507,7 +2131,7 @@ void parse_tologin(Session *ls)
                 for (CharPair& cp : char_keys)
                 {
                     CharKey *k = &cp.key;
-                    CharData& cd = *cp.data.get();
+                    CharData& cd = cp.mut();
                     CharData *c = &cd;
                     Borrowed<Storage> s = account2storage(k->account_id);
                     int changes = 0;
@@ -1531,9 +2155,12 @@ void parse_tologin(Session *ls)
                     }
 #undef FIX
                     if (changes)
+                    {
+                        inter_storage_dirty(k->account_id);
                         CHAR_LOG("itemfrob(%d -> %d):  `%s'(%d, account %d): changed %d times\n"_fmt,
                                 source_id, dest_id, k->name, k->char_id,
                                 k->account_id, changes);
+                    }
 
                 }
 
@@ -1553,29 +2180,10 @@ void parse_tologin(Session *ls)
                 AccountId aid = fixed.account_id;
 
                 // Deletion of all characters of the account
-//#warning "This comment is a lie, but it's still true."
-                // needs to use index because they may move during resize
-                for (int idx = 0; idx < char_keys.size(); idx++)
+                for (CharPair *cp : account_chars(aid))
                 {
-                    CharPair& cp = char_keys[idx];
-                    CharKey& ck = cp.key;
-                    if (ck.account_id == aid)
-                    {
-                        char_delete(&cp);
-                        if (&cp != &char_keys.back())
-                        {
-                            std::swap(cp, char_keys.back());
-                            // if moved character owns to deleted account, check again it's character
-                            // YES this is the newly swapped one
-                            // we could avoid this by working backwards
-                            if (ck.account_id == aid)
-                            {
-                                idx--;
-                                // Correct moved character reference in the character's owner by [Yor]
-                            }
-                        }
-                        char_keys.pop_back();
-                    }
+                    char_delete(cp);
+                    char_erase(cp);
                 }
                 // Deletion of the storage
                 inter_storage_delete(aid);
@@ -1637,6 +2245,7 @@ void parse_tologin(Session *ls)
                             gm_accounts.size());
                     CHAR_LOG("From login-server: receiving of %zu GM accounts information.\n"_fmt,
                             gm_accounts.size());
+                    online_dirty = true;
                     create_online_files(); // update online players files (perhaps some online players change of GM level)
                     // send new gm acccounts level to map-servers
                     std::vector<Packet_Repeat<0x2b15>> repeat_15(repeat.size());
@@ -1862,26 +2471,23 @@ void parse_frommap(Session *ms)
                         (!check_ip_flag || afi.ip == ip)
                         && !afi.delflag)
                     {
-                        CharPair *cp = nullptr;
-                        for (CharPair& cdi : char_keys)
-                        {
-                            if (cdi.key.char_id == afi.char_id)
-                            {
-                                cp = &cdi;
-                                break;
-                            }
-                        }
+                        CharPair *cp = search_character_id_m(afi.char_id);
                         assert (cp && "uh-oh - deleted while in queue?"_s);
 
                         CharKey *ck = &cp->key;
-                        CharData *cd = cp->data.get();
+                        const CharData *cd = cp->data.get();
 
                         afi.delflag = 1;
                         Packet_Payload<0x2afd> payload_fd; // not file descriptor
                         payload_fd.account_id = account_id;
                         payload_fd.login_id2 = afi.login_id2;
                         payload_fd.connect_until = afi.connect_until_time;
-                        cd->sex = afi.sex;
+                        if (cd->sex != afi.sex)
+                        {
+                            cp->mut().sex = afi.sex;
+                            cd = cp->data.get();
+                            char_journal_put(cp);
+                        }
                         payload_fd.packet_tmw_version = afi.packet_tmw_version;
                         FPRINTF(stderr,
                                 "From queue index %zd: recalling packet version %d\n"_fmt,
@@ -1916,34 +2522,33 @@ void parse_frommap(Session *ms)
                 assert (head.users == repeat.size());
                 if (anti_freeze_enable)
                     server_freezeflag[id] = 5;  // Map anti-freeze system. Counter. 5 ok, 4...0 freezed
-                // remove all previously online players of the server
-                for (Session *& oci : online_chars)
-                {
-                    // there was a bug here
-                    if (oci == ms)
-                        oci = nullptr;
-                }
-                // add online players in the list by [Yor]
+                // The server sends its whole list every 5 s, and it is
+                // nearly always the same, so only touch online_chars
+                // (and the online files) when it differs.
+                std::vector<CharId> was, now;
+                for (const auto& pair : online_chars)
+                    if (pair.second == ms)
+                        was.push_back(pair.first);
                 for (int i = 0; i < server[id].users; i++)
                 {
                     CharId char_id = repeat[i].char_id;
-                    for (const CharPair& cd : char_keys)
-                    {
-                        if (cd.key.char_id == char_id)
-                        {
-                            server_for_m(&cd) = ms;
-                            break;
-                        }
-                    }
+                    if (char_by_id.count(char_id))
+                        now.push_back(char_id);
                 }
-                if (update_online < TimeT::now())
+                std::sort(was.begin(), was.end());
+                std::sort(now.begin(), now.end());
+                now.erase(std::unique(now.begin(), now.end()), now.end());
+                if (was != now)
                 {
-                    // Time is done
-                    update_online = static_cast<time_t>(TimeT::now()) + 8;
-                    create_online_files();
-                    // only every 8 sec. (normally, 1 server send users every 5 sec.) Don't update every time, because that takes time, but only every 2 connection.
-                    // it set to 8 sec because is more than 5 (sec) and if we have more than 1 map-server, informations can be received in shifted.
+                    // remove all previously online players of the server
+                    for (CharId char_id : was)
+                        online_chars.erase(char_id);
+                    // add online players in the list by [Yor]
+                    for (CharId char_id : now)
+                        online_chars[char_id] = ms;
+                    online_dirty = true;
                 }
+                // written by create_online_files_timer
                 break;
             }
 
@@ -1957,16 +2562,50 @@ void parse_frommap(Session *ms)
 
                 AccountId aid = payload.account_id;
                 CharId cid = payload.char_id;
-                for (CharPair& cd : char_keys)
+                CharPair *cd = search_character_id_m(cid);
+                if (cd && cd->key.account_id == aid)
                 {
-                    if (cd.key.account_id == aid &&
-                        cd.key.char_id == cid)
-                    {
-                        cd.key = payload.char_key;
-                        *cd.data = payload.char_data;
-                        break;
-                    }
+                    char_rekey(cd, payload.char_key);
+                    cd->mut() = payload.char_data;
+                    char_journal_put(cd);
+                }
+                break;
+            }
+
+                // キャラデータ差分保存
+            case 0x2b17:
+            {
+                Packet_Head<0x2b17> head;
+                std::vector<Packet_Repeat<0x2b17>> repeat;
+                rv = recv_vpacket<0x2b17, 53, 10>(ms, head, repeat);
+                if (rv != RecvResult::Complete)
+                    break;
+
+                AccountId aid = head.account_id;
+                CharId cid = head.char_id;
+                CharPair *cd = search_character_id_m(cid);
+                if (!cd || cd->key.account_id != aid)
+                    break;
+
+                // The delta is against what the map-server sent last;
+                // if that is not what we have, ask for all of it.
+                auto image = make_unique<NetCharData>();
+                auto data = make_unique<CharData>();
+                if (!native_to_network(image.get(), *cd->data)
+                        || char_delta_checksum(*image) != head.base_checksum
+                        || !char_delta_apply(*image, repeat)
+                        || !network_to_native(data.get(), *image))
+                {
+                    CHAR_LOG("Delta save of character %d (%s) does not match; asking for a full save.\n"_fmt,
+                            cid, cd->key.name);
+                    Packet_Fixed<0x2b18> fixed_18;
+                    fixed_18.char_id = cid;
+                    send_fpacket<0x2b18, 6>(ms, fixed_18);
+                    break;
                 }
+                char_rekey(cd, head.char_key);
+                cd->data = std::move(data);
+                char_journal_put(cd);
                 break;
             }
 
@@ -2030,16 +2669,14 @@ void parse_frommap(Session *ms)
 
                 // default, if not found in the loop
                 fixed_06.error = 1;
-                for (const CharPair& cd : char_keys)
                 {
                     AccountId aid = fixed.account_id;
                     CharId cid = fixed.char_id;
-                    if (cd.key.account_id == aid &&
-                        cd.key.char_id == cid)
+                    const CharPair *cd = search_character_id(cid);
+                    if (cd && cd->key.account_id == aid)
                     {
                         auth_fifo_iter++;
                         fixed_06.error = 0;
-                        break;
                     }
                 }
                 send_fpacket<0x2b06, 44>(ms, fixed_06);
@@ -2280,14 +2917,8 @@ void parse_frommap(Session *ms)
 
                 {
                     CharId cid = fixed.char_id;
-                    for (CharPair& cd : char_keys)
-                    {
-                        if (cd.key.char_id == cid)
-                        {
-                            char_divorce(&cd);
-                            break;
-                        }
-                    }
+                    if (CharPair *cd = search_character_id_m(cid))
+                        char_divorce(cd);
 
                     break;
 
@@ -2350,18 +2981,18 @@ void handle_x0066(Session *s, struct char_session_data *sd, uint8_t rfifob_2, IP
 {
     {
         CharPair *cp = nullptr;
-        for (CharPair& cdi : char_keys)
+        for (CharPair *cdi : account_chars(sd->account_id))
         {
-            if (cdi.key.account_id == sd->account_id && cdi.key.char_num == rfifob_2)
+            if (cdi->key.char_num == rfifob_2)
             {
-                cp = &cdi;
+                cp = cdi;
                 break;
             }
         }
         if (cp)
         {
             CharKey *ck = &cp->key;
-            CharData *cd = cp->data.get();
+            const CharData *cd = cp->data.get();
 
             CHAR_LOG("Character Selected, Account ID: %d, Character Slot: %d, Character Name: %s [%s]\n"_fmt,
                     sd->account_id, rfifob_2,
@@ -2379,7 +3010,9 @@ void handle_x0066(Session *s, struct char_session_data *sd, uint8_t rfifob_2, IP
                         && server[j].maps[0])
                     {   // change save point to one of map found on the server (the first)
                         i = j;
-                        cd->last_point.map_ = server[j].maps[0];
+                        cp->mut().last_point.map_ = server[j].maps[0];
+                        cd = cp->data.get();
+                        char_journal_put(cp);
                         PRINTF("Map-server #%d found with a map: '%s'.\n"_fmt,
                                 j, server[j].maps[0]);
                         // coordonates are unknown
@@ -2672,27 +3305,14 @@ void parse_char(Session *s)
                 {
                     {
                         CharId cid = fixed.char_id;
-                        CharPair *cs = nullptr;
-                        for (CharPair& cd : char_keys)
-                        {
-                            if (cd.key.char_id == cid)
-                            {
-                                if (cd.key.account_id == sd->account_id)
-                                    cs = &cd;
-                                break;
-                            }
-                        }
+                        CharPair *cs = search_character_id_m(cid);
+                        if (cs && cs->key.account_id != sd->account_id)
+                            cs = nullptr;
 
                         if (cs)
                         {
                             char_delete(cs);   // deletion process
-
-                            if (cs != &char_keys.back())
-                            {
-                                std::swap(*cs, char_keys.back());
-                            }
-
-                            char_keys.pop_back();
+                            char_erase(cs);
                             Packet_Fixed<0x006f> fixed_6f;
                             send_fpacket<0x006f, 2>(s, fixed_6f);
                             goto x68_out;
@@ -2980,6 +3600,10 @@ bool char_config(XString w1, ZString w2)
         {
             char_txt = w2;
         }
+        else if (w1 == "binary_snapshots"_s)
+        {
+            binary_snapshots = config_switch(w2);
+        }
         else if (w1 == "max_connect_user"_s)
         {
             max_connect_user = atoi(w2.c_str());
@@ -3028,6 +3652,10 @@ bool char_config(XString w1, ZString w2)
         {
             online_html_filename = w2;
         }
+        else if (w1 == "online_json_filename"_s)
+        {
+            online_json_filename = w2;
+        }
         else if (w1 == "online_sorting_option"_s)
         {
             online_sorting_option = atoi(w2.c_str());
@@ -3065,15 +3693,19 @@ bool char_config(XString w1, ZString w2)
 void term_func(void)
 {
     // write online players files with no player
-    std::fill(online_chars.begin(), online_chars.end(), nullptr);
-    create_online_files();
+    online_writer_stop();
     online_chars.clear();
+    online_dirty = true;
+    create_online_files();
 
     mmo_char_sync();
     inter_save();
 
     gm_accounts.clear();
 
+    char_by_id.clear();
+    char_by_name.clear();
+    char_by_account.clear();
     char_keys.clear();
     delete_session(login_session);
     delete_session(char_session);
@@ -3098,6 +3730,7 @@ int do_init(Slice<ZString> argv)
     ZString argv0 = argv.pop_front();
 
     bool loaded_config_yet = false;
+    Option<bool> convert_to_binary = None;
     while (argv)
     {
         ZString argvi = argv.pop_front();
@@ -3105,8 +3738,10 @@ int do_init(Slice<ZString> argv)
         {
             if (argvi == "--help"_s)
             {
-                PRINTF("Usage: %s [--help] [--version] [files...]\n"_fmt,
+                PRINTF("Usage: %s [--help] [--version] [--convert-text | --convert-binary] [files...]\n"_fmt,
                         argv0);
+                PRINTF("  --convert-text, --convert-binary: rewrite the character, party,\n"_fmt);
+                PRINTF("    storage and account variable files in that format, then exit\n"_fmt);
                 exit(0);
             }
             else if (argvi == "--version"_s)
@@ -3114,6 +3749,14 @@ int do_init(Slice<ZString> argv)
                 PRINTF("%s\n"_fmt, CURRENT_VERSION_STRING);
                 exit(0);
             }
+            else if (argvi == "--convert-text"_s)
+            {
+                convert_to_binary = Some(false);
+            }
+            else if (argvi == "--convert-binary"_s)
+            {
+                convert_to_binary = Some(true);
+            }
             else
             {
                 FPRINTF(stderr, "Unknown argument: %s\n"_fmt, argvi);
@@ -3130,16 +3773,29 @@ int do_init(Slice<ZString> argv)
     if (!loaded_config_yet)
         runflag &= load_config_file("conf/tmwa-char.conf"_s, char_confs);
 
+    if OPTION_IS_SOME(binary, convert_to_binary)
+    {
+        if (!runflag)
+            exit(1);
+        binary_snapshots = binary;
+        char_load_all();
+        mmo_char_sync();
+        inter_storage_dirty_all();
+        inter_save();
+        PRINTF("Converted the char-server files to %s.\n"_fmt,
+                binary ? "binary snapshots"_s : "text"_s);
+        exit(0);
+    }
+
     // a newline in the log...
     CHAR_LOG(""_fmt);
     CHAR_LOG("The char-server starting...\n"_fmt);
 
     runflag &= lan_check();
 
-    mmo_char_init();
-    inter_init2();
+    char_load_all();
 
-    update_online = TimeT::now();
+    online_writer = std::thread(online_writer_main);
     create_online_files();     // update online players files at start of the server
 
     char_session = make_listen_port(char_port, SessionParsers{parse_char, delete_char});
@@ -3156,6 +3812,14 @@ int do_init(Slice<ZString> argv)
             mmo_char_sync_timer,
             autosave_time
     ).detach();
+    Timer(gettick() + 1_s,
+            char_journal_sync_timer,
+            1_s
+    ).detach();
+    Timer(gettick() + ONLINE_FILES_INTERVAL,
+            create_online_files_timer,
+            ONLINE_FILES_INTERVAL
+    ).detach();
 
     if (anti_freeze_enable > 0)
     {
@@ -41,6 +41,10 @@ struct mmo_map_server
     Array<MapName, MAX_MAP_PER_SERVER> maps;
 };
 
+// write char_txt, party_txt, storage_txt and accreg_txt as binary
+// snapshots instead of text (reading accepts either)
+extern bool binary_snapshots;
+
 const CharPair *search_character(CharName character_name);
 const CharPair *search_character_id(CharId char_id);
 Session *server_for(const CharPair *mcs);
@@ -35,4 +35,5 @@
 namespace tmwa
 {
 // meh, add more when I feel like it
+struct LoadJob;
 } // namespace tmwa
@@ -20,6 +20,9 @@
 //    You should have received a copy of the GNU General Public License
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <utility>
+#include <vector>
+
 #include "../ints/udl.hpp"
 
 #include "../strings/mstring.hpp"
@@ -32,6 +35,7 @@
 #include "../io/extract.hpp"
 #include "../io/lock.hpp"
 #include "../io/read.hpp"
+#include "../io/snapshot.hpp"
 #include "../io/write.hpp"
 
 #include "../proto2/char-map.hpp"
@@ -152,10 +156,79 @@ void party_check_deleted_init(PartyPair p)
     }
 }
 
-// パーティデータのロード
-void inter_party_init(void)
+// A party in a binary snapshot of party_txt.
+struct NetPartyRecord
+{
+    Little32 party_id;
+    NetPartyMost most;
+};
+static_assert(alignof(NetPartyRecord) == 1, "alignof(NetPartyRecord) == 1");
+constexpr uint32_t PARTY_SNAPSHOT_KIND = io::snapshot_kind("PRTY");
+constexpr uint32_t PARTY_SNAPSHOT_VERSION = 1;
+
+// What party_txt held, until inter_party_init() loads it.
+struct PartyLoad
+{
+    AString filename;
+    bool damaged = false;
+    PartyId newid;
+    std::vector<std::pair<PartyId, PartyMost>> parties;
+};
+static
+PartyLoad party_loaded;
+
+static
+void inter_party_load(PartyId party_id, PartyMost& pm)
+{
+    PartyPair pp{party_id, borrow(pm)};
+    if (party_newid < next(party_id))
+        party_newid = next(party_id);
+    party_check_deleted_init(pp);
+    party_db.insert(party_id, pm);
+    // note: this is still referring to the noncanonical copy of
+    // the PartyMost pointer. This is okay, though.
+    party_check_empty(pp);
+}
+
+static
+void inter_party_read_snapshot(io::SnapshotReader& snap, PartyLoad& load)
 {
-    io::ReadFile in(party_txt);
+    if (!snap.check(PARTY_SNAPSHOT_KIND, PARTY_SNAPSHOT_VERSION, sizeof(NetPartyRecord)))
+    {
+        load.damaged = true;
+        return;
+    }
+    load.newid = wrap<PartyId>(static_cast<uint32_t>(snap.next_id()));
+    load.parties.reserve(snap.size());
+    for (size_t i = 0, n = snap.size(); i < n; ++i)
+    {
+        const NetPartyRecord& rec = snap.get<NetPartyRecord>(i);
+        PartyId party_id;
+        PartyMost pm;
+        if (network_to_native(&party_id, rec.party_id)
+            && network_to_native(&pm, rec.most)
+            && party_id)
+            load.parties.emplace_back(party_id, pm);
+        else
+            PRINTF("int_party: broken data [%s] record %zu\n"_fmt, load.filename, i);
+    }
+}
+
+// パーティデータの読み込み
+//   (runs on a loader thread)
+static
+void inter_party_read(PartyLoad& load)
+{
+    {
+        io::SnapshotReader snap(load.filename);
+        if (snap.is_snapshot())
+        {
+            inter_party_read_snapshot(snap, load);
+            return;
+        }
+    }
+
+    io::ReadFile in(load.filename);
     if (!in.is_open())
         return;
 
@@ -166,9 +239,9 @@ void inter_party_init(void)
     {
         PartyId i;
         if (extract(line, record<'\t'>(&i, "%newid%"_s))
-            && party_newid < i)
+            && load.newid < i)
         {
-            party_newid = i;
+            load.newid = i;
             continue;
         }
 
@@ -176,23 +249,39 @@ void inter_party_init(void)
         PartyPair pp{PartyId(), borrow(pm)};
         if (extract(line, &pp) && pp.party_id)
         {
-            if (party_newid < next(pp.party_id))
-                party_newid = next(pp.party_id);
-            party_check_deleted_init(pp);
-            party_db.insert(pp.party_id, pm);
-            // note: this is still referring to the noncanonical copy of
-            // the PartyMost pointer. This is okay, though.
-            party_check_empty(pp);
+            load.parties.emplace_back(pp.party_id, pm);
         }
         else
         {
-            PRINTF("int_party: broken data [%s] line %d\n"_fmt, party_txt,
+            PRINTF("int_party: broken data [%s] line %d\n"_fmt, load.filename,
                     c + 1);
         }
         c++;
     }
 }
 
+void inter_party_init_jobs(std::vector<LoadJob>& jobs)
+{
+    party_loaded.filename = AString(party_txt.begin(), party_txt.end());
+    jobs.push_back(LoadJob{"parties"_s, []() { inter_party_read(party_loaded); }});
+}
+
+// パーティデータのロード
+//   (after the characters, which the members are checked against)
+void inter_party_init(void)
+{
+    if (party_loaded.damaged)
+    {
+        PRINTF("int_party: [%s] is damaged\n"_fmt, party_txt);
+        exit(1);
+    }
+    if (party_newid < party_loaded.newid)
+        party_newid = party_loaded.newid;
+    for (auto& pair : party_loaded.parties)
+        inter_party_load(pair.first, pair.second);
+    party_loaded = PartyLoad();
+}
+
 // パーティーデータのセーブ用
 static
 void inter_party_save_sub(PartyPair data, io::WriteFile& fp)
@@ -211,6 +300,19 @@ int inter_party_save(void)
                 party_txt);
         return 1;
     }
+    if (binary_snapshots)
+    {
+        io::SnapshotWriter snap(fp, PARTY_SNAPSHOT_KIND, PARTY_SNAPSHOT_VERSION,
+                sizeof(NetPartyRecord), unwrap<PartyId>(party_newid));
+        for (auto& pair : party_db)
+        {
+            NetPartyRecord rec;
+            if (native_to_network(&rec.party_id, pair.first)
+                && native_to_network(&rec.most, pair.second))
+                snap.put(rec);
+        }
+        return 0;
+    }
     for (auto& pair : party_db)
     {
         PartyPair tmp{pair.first, borrow(pair.second)};
@@ -22,9 +22,12 @@
 
 #include "fwd.hpp"
 
+#include <vector>
+
 
 namespace tmwa
 {
+void inter_party_init_jobs(std::vector<LoadJob>& jobs);
 void inter_party_init(void);
 int inter_party_save(void);
 
@@ -20,6 +20,11 @@
 //    You should have received a copy of the GNU General Public License
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <cstdio>
+
+#include <bitset>
+#include <vector>
+
 #include "../strings/mstring.hpp"
 #include "../strings/astring.hpp"
 #include "../strings/xstring.hpp"
@@ -31,6 +36,7 @@
 #include "../io/extract.hpp"
 #include "../io/lock.hpp"
 #include "../io/read.hpp"
+#include "../io/snapshot.hpp"
 #include "../io/write.hpp"
 
 #include "../proto2/char-map.hpp"
@@ -42,6 +48,9 @@
 
 #include "../wire/packets.hpp"
 
+#include "char.hpp"
+#include "inter.hpp"
+
 #include "../poison.hpp"
 
 
@@ -118,44 +127,181 @@ bool extract(XString str, Storage *p)
     return true;
 }
 
-// アカウントから倉庫データインデックスを得る（新規倉庫追加可能）
-Borrowed<Storage> account2storage(AccountId account_id)
+// 倉庫データのバイナリスナップショット
+constexpr uint32_t STORAGE_SNAPSHOT_KIND = io::snapshot_kind("STOR");
+constexpr uint32_t STORAGE_SNAPSHOT_VERSION = 1;
+
+// Storages are saved in STORAGE_BUCKETS files next to storage_txt, by
+// account id, and a save only rewrites the buckets that changed.
+// Each bucket has the same format as storage_txt itself.
+constexpr unsigned STORAGE_BUCKETS = 64;
+static
+std::bitset<STORAGE_BUCKETS> storage_dirty;
+// storage_txt itself was read at startup and should be retired
+// once every bucket has been written
+static
+bool storage_migrate = false;
+
+static
+unsigned storage_bucket(AccountId account_id)
 {
-    P<Storage> s = storage_db.init(account_id);
-    s->account_id = account_id;
-    return s;
+    return unwrap<AccountId>(account_id) % STORAGE_BUCKETS;
 }
 
-//---------------------------------------------------------
-// 倉庫データを読み込む
-void inter_storage_init(void)
+static
+AString storage_bucket_txt(unsigned bucket)
 {
-    int c = 0;
+    return STRPRINTF("%s.b%02u"_fmt, storage_txt, bucket);
+}
 
-    io::ReadFile in(storage_txt);
-    if (!in.is_open())
+// What one storage file held, until inter_storage_init() loads it.
+struct StorageFileLoad
+{
+    AString filename;
+    Option<unsigned> bucket = None;
+    bool found = false, damaged = false;
+    std::vector<Storage> stors;
+};
+static
+std::vector<StorageFileLoad> storage_loads;
+
+static
+void inter_storage_load(const Storage& s, Option<unsigned> bucket)
+{
+    storage_db.insert(s.account_id, s);
+    if OPTION_IS_SOME(b, bucket)
     {
-        PRINTF("cant't read : %s\n"_fmt, storage_txt);
+        // STORAGE_BUCKETS changed since it was written
+        if (b != storage_bucket(s.account_id))
+        {
+            storage_dirty[b] = true;
+            storage_dirty[storage_bucket(s.account_id)] = true;
+        }
+    }
+}
+
+static
+void inter_storage_read_snapshot(io::SnapshotReader& snap, StorageFileLoad& load)
+{
+    if (!snap.check(STORAGE_SNAPSHOT_KIND, STORAGE_SNAPSHOT_VERSION, sizeof(NetStorage)))
+    {
+        load.damaged = true;
         return;
     }
+    load.stors.reserve(snap.size());
+    for (size_t i = 0, n = snap.size(); i < n; ++i)
+    {
+        Storage s {};
+        if (network_to_native(&s, snap.get<NetStorage>(i)) && s.account_id)
+            load.stors.push_back(s);
+        else
+            PRINTF("int_storage: broken data [%s] record %zu\n"_fmt,
+                    load.filename, i);
+    }
+}
+
+// runs on a loader thread
+static
+void inter_storage_read(StorageFileLoad& load)
+{
+    {
+        io::SnapshotReader snap(load.filename);
+        if (snap.is_snapshot())
+        {
+            load.found = true;
+            inter_storage_read_snapshot(snap, load);
+            return;
+        }
+    }
+
+    io::ReadFile in(load.filename);
+    if (!in.is_open())
+        return;
+    load.found = true;
 
+    int c = 0;
     AString line;
     while (in.getline(line))
     {
         Storage s {};
         if (extract(line, &s))
         {
-            storage_db.insert(s.account_id, s);
+            load.stors.push_back(s);
         }
         else
         {
             PRINTF("int_storage: broken data [%s] line %d\n"_fmt,
-                    storage_txt, c);
+                    load.filename, c);
         }
         c++;
     }
 }
 
+// アカウントから倉庫データインデックスを得る（新規倉庫追加可能）
+Borrowed<Storage> account2storage(AccountId account_id)
+{
+    P<Storage> s = storage_db.init(account_id);
+    s->account_id = account_id;
+    return s;
+}
+
+void inter_storage_dirty(AccountId account_id)
+{
+    storage_dirty[storage_bucket(account_id)] = true;
+}
+
+void inter_storage_dirty_all(void)
+{
+    storage_dirty.set();
+}
+
+//---------------------------------------------------------
+// 倉庫データを読み込む
+//   (storage_txt is only read if it was not split into buckets yet;
+//   a bucket overrides whatever it says about its accounts)
+void inter_storage_init_jobs(std::vector<LoadJob>& jobs)
+{
+    storage_loads.resize(1 + STORAGE_BUCKETS);
+    storage_loads[0].filename = AString(storage_txt.begin(), storage_txt.end());
+    for (unsigned b = 0; b < STORAGE_BUCKETS; ++b)
+    {
+        storage_loads[1 + b].filename = storage_bucket_txt(b);
+        storage_loads[1 + b].bucket = Some(b);
+    }
+    for (StorageFileLoad& load : storage_loads)
+    {
+        StorageFileLoad *l = &load;
+        jobs.push_back(LoadJob{"storage"_s, [l]() { inter_storage_read(*l); }});
+    }
+}
+
+void inter_storage_init(void)
+{
+    bool found = false;
+    for (StorageFileLoad& load : storage_loads)
+    {
+        if (load.damaged)
+        {
+            PRINTF("int_storage: [%s] is damaged\n"_fmt, load.filename);
+            exit(1);
+        }
+        if (!load.found)
+            continue;
+        found = true;
+        if (&load == &storage_loads.front())
+        {
+            // storage_txt itself, to be rewritten as buckets
+            storage_migrate = true;
+            storage_dirty.set();
+        }
+        for (const Storage& s : load.stors)
+            inter_storage_load(s, load.bucket);
+    }
+    if (!found)
+        PRINTF("cant't read : %s\n"_fmt, storage_txt);
+    storage_loads.clear();
+}
+
 static
 void inter_storage_save_sub(Storage *data, io::WriteFile& fp)
 {
@@ -164,27 +310,76 @@ void inter_storage_save_sub(Storage *data, io::WriteFile& fp)
         fp.put_line(line);
 }
 
-//---------------------------------------------------------
-// 倉庫データを書き込む
-int inter_storage_save(void)
+static
+int inter_storage_save_bucket(unsigned bucket, const std::vector<Storage *>& stors)
 {
-    io::WriteLock fp(storage_txt);
+    AString filename = storage_bucket_txt(bucket);
+    io::WriteLock fp(filename);
 
     if (!fp.is_open())
     {
         PRINTF("int_storage: cant write [%s] !!! data is lost !!!\n"_fmt,
-                storage_txt);
+                filename);
         return 1;
     }
-    for (auto& pair : storage_db)
-        inter_storage_save_sub(&pair.second, fp);
+    if (binary_snapshots)
+    {
+        io::SnapshotWriter snap(fp, STORAGE_SNAPSHOT_KIND, STORAGE_SNAPSHOT_VERSION,
+                sizeof(NetStorage), 0);
+        for (Storage *st : stors)
+        {
+            NetStorage rec;
+            if (native_to_network(&rec, *st))
+                snap.put(rec);
+        }
+        return 0;
+    }
+    for (Storage *st : stors)
+        inter_storage_save_sub(st, fp);
     return 0;
 }
 
+//---------------------------------------------------------
+// 倉庫データを書き込む
+//   (only the buckets that changed since the last save)
+int inter_storage_save(void)
+{
+    if (storage_dirty.none())
+        return 0;
+
+    std::vector<Storage *> stors[STORAGE_BUCKETS];
+    for (auto& pair : storage_db)
+    {
+        unsigned b = storage_bucket(pair.first);
+        if (storage_dirty[b])
+            stors[b].push_back(&pair.second);
+    }
+
+    int rv = 0;
+    for (unsigned b = 0; b < STORAGE_BUCKETS; ++b)
+    {
+        if (!storage_dirty[b])
+            continue;
+        if (inter_storage_save_bucket(b, stors[b]))
+            rv = 1;
+        else
+            storage_dirty[b] = false;
+    }
+
+    if (storage_migrate && storage_dirty.none())
+    {
+        AString old = STRPRINTF("%s.old"_fmt, storage_txt);
+        rename(storage_txt.c_str(), old.c_str());
+        storage_migrate = false;
+    }
+    return rv;
+}
+
 // 倉庫データ削除
 void inter_storage_delete(AccountId account_id)
 {
     storage_db.erase(account_id);
+    inter_storage_dirty(account_id);
 }
 
 //---------------------------------------------------------
@@ -243,6 +438,7 @@ RecvResult mapif_parse_SaveStorage(Session *ss)
     {
         P<Storage> st = account2storage(account_id);
         *st = payload.storage;
+        inter_storage_dirty(account_id);
         mapif_save_storage_ack(ss, account_id);
     }
 
@@ -22,12 +22,17 @@
 
 #include "fwd.hpp"
 
+#include <vector>
+
 
 namespace tmwa
 {
+void inter_storage_init_jobs(std::vector<LoadJob>& jobs);
 void inter_storage_init(void);
 int inter_storage_save(void);
 void inter_storage_delete(AccountId account_id);
+void inter_storage_dirty(AccountId account_id);
+void inter_storage_dirty_all(void);
 Borrowed<Storage> account2storage(AccountId account_id);
 
 RecvResult inter_storage_parse_frommap(Session *ms, uint16_t);
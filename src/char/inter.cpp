@@ -37,6 +37,7 @@
 #include "../io/extract.hpp"
 #include "../io/lock.hpp"
 #include "../io/read.hpp"
+#include "../io/snapshot.hpp"
 #include "../io/write.hpp"
 
 #include "../proto2/char-map.hpp"
@@ -103,13 +104,90 @@ bool extract(XString str, struct accreg *reg)
     return true;
 }
 
+// What accreg_txt held, until inter_accreg_init() loads it.
+struct AccregLoad
+{
+    AString filename;
+    bool damaged = false;
+    std::vector<struct accreg> regs;
+};
+static
+AccregLoad accreg_loaded;
+
+// アカウント変数のバイナリスナップショット
+struct NetAccregRecord
+{
+    Little32 account_id;
+    Little32 reg_num;
+    NetArray<NetGlobalReg, ACCOUNT_REG_NUM> reg;
+};
+static_assert(alignof(NetAccregRecord) == 1, "alignof(NetAccregRecord) == 1");
+constexpr uint32_t ACCREG_SNAPSHOT_KIND = io::snapshot_kind("AREG");
+constexpr uint32_t ACCREG_SNAPSHOT_VERSION = 1;
+
+static
+void inter_accreg_read_snapshot(io::SnapshotReader& snap, AccregLoad& load)
+{
+    if (!snap.check(ACCREG_SNAPSHOT_KIND, ACCREG_SNAPSHOT_VERSION, sizeof(NetAccregRecord)))
+    {
+        load.damaged = true;
+        return;
+    }
+    load.regs.reserve(snap.size());
+    for (size_t i = 0, n = snap.size(); i < n; ++i)
+    {
+        const NetAccregRecord& rec = snap.get<NetAccregRecord>(i);
+        struct accreg reg {};
+        uint32_t reg_num;
+        if (network_to_native(&reg.account_id, rec.account_id)
+            && network_to_native(&reg_num, rec.reg_num)
+            && network_to_native(&reg.reg, rec.reg)
+            && reg.account_id && reg_num <= ACCOUNT_REG_NUM)
+        {
+            reg.reg_num = reg_num;
+            load.regs.push_back(reg);
+        }
+        else
+            PRINTF("inter: accreg: broken data [%s] record %zu\n"_fmt,
+                    load.filename, i);
+    }
+}
+
+static
+void inter_accreg_write_snapshot(io::WriteFile& fp)
+{
+    io::SnapshotWriter snap(fp, ACCREG_SNAPSHOT_KIND, ACCREG_SNAPSHOT_VERSION,
+            sizeof(NetAccregRecord), 0);
+    for (auto& pair : accreg_db)
+    {
+        struct accreg *reg = &pair.second;
+        if (reg->reg_num <= 0)
+            continue;
+        NetAccregRecord rec;
+        if (native_to_network(&rec.account_id, reg->account_id)
+            && native_to_network(&rec.reg_num, static_cast<uint32_t>(reg->reg_num))
+            && native_to_network(&rec.reg, reg->reg))
+            snap.put(rec);
+    }
+}
+
 // アカウント変数の読み込み
+//   (runs on a loader thread)
 static
-void inter_accreg_init(void)
+void inter_accreg_read(AccregLoad& load)
 {
     int c = 0;
 
-    io::ReadFile in(accreg_txt);
+    {
+        io::SnapshotReader snap(load.filename);
+        if (snap.is_snapshot())
+        {
+            inter_accreg_read_snapshot(snap, load);
+            return;
+        }
+    }
+
+    io::ReadFile in(load.filename);
     if (!in.is_open())
         return;
     AString line;
@@ -118,17 +196,30 @@ void inter_accreg_init(void)
         struct accreg reg {};
         if (extract(line, &reg))
         {
-            accreg_db.insert(reg.account_id, reg);
+            load.regs.push_back(reg);
         }
         else
         {
-            PRINTF("inter: accreg: broken data [%s] line %d\n"_fmt, accreg_txt,
+            PRINTF("inter: accreg: broken data [%s] line %d\n"_fmt, load.filename,
                     c);
         }
         c++;
     }
 }
 
+static
+void inter_accreg_init(void)
+{
+    if (accreg_loaded.damaged)
+    {
+        PRINTF("inter: accreg: [%s] is damaged\n"_fmt, accreg_txt);
+        exit(1);
+    }
+    for (const struct accreg& reg : accreg_loaded.regs)
+        accreg_db.insert(reg.account_id, reg);
+    accreg_loaded = AccregLoad();
+}
+
 // アカウント変数のセーブ用
 static
 void inter_accreg_save_sub(struct accreg *reg, io::WriteFile& fp)
@@ -151,6 +242,11 @@ int inter_accreg_save(void)
                 accreg_txt);
         return 1;
     }
+    if (binary_snapshots)
+    {
+        inter_accreg_write_snapshot(fp);
+        return 0;
+    }
     for (auto& pair : accreg_db)
         inter_accreg_save_sub(&pair.second, fp);
 
@@ -195,7 +291,16 @@ void inter_save(void)
     inter_accreg_save();
 }
 
+void inter_init_jobs(std::vector<LoadJob>& jobs)
+{
+    inter_party_init_jobs(jobs);
+    inter_storage_init_jobs(jobs);
+    accreg_loaded.filename = AString(accreg_txt.begin(), accreg_txt.end());
+    jobs.push_back(LoadJob{"accreg"_s, []() { inter_accreg_read(accreg_loaded); }});
+}
+
 // 初期化
+//   (after the read jobs are done)
 void inter_init2()
 {
     inter_party_init();
@@ -22,10 +22,26 @@
 
 #include "fwd.hpp"
 
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include "../strings/literal.hpp"
+
 
 namespace tmwa
 {
+/// One file to parse at startup.  read() may run on any thread, so it
+/// only fills buffers belonging to its job; inter_init2() loads them.
+struct LoadJob
+{
+    LString store;
+    std::function<void()> read;
+    std::chrono::steady_clock::duration elapsed {};
+};
+
 bool inter_config(XString key, ZString value);
+void inter_init_jobs(std::vector<LoadJob>& jobs);
 void inter_init2();
 void inter_save(void);
 RecvResult inter_parse_frommap(Session *ms, uint16_t packet_id);
@@ -0,0 +1,85 @@
+#include "char_delta.hpp"
+//    char_delta.cpp - Incremental character saves between map and char.
+//
+//    Copyright © 2026 The Mana World Development Team
+//
+//    This file is part of The Mana World (Athena server)
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+
+#include "../io/snapshot.hpp"
+
+#include "../poison.hpp"
+
+
+namespace tmwa
+{
+// The last block is short; the bytes past the end read as zero.
+static
+uint64_t get_block(const NetCharData& image, size_t b)
+{
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&image);
+    size_t off = b * CHAR_DELTA_BLOCK;
+    size_t len = std::min(CHAR_DELTA_BLOCK, sizeof(NetCharData) - off);
+    uint64_t rv = 0;
+    for (size_t i = 0; i < len; ++i)
+        rv |= uint64_t(bytes[off + i]) << (8 * i);
+    return rv;
+}
+
+static
+void put_block(NetCharData& image, size_t b, uint64_t data)
+{
+    uint8_t *bytes = reinterpret_cast<uint8_t *>(&image);
+    size_t off = b * CHAR_DELTA_BLOCK;
+    size_t len = std::min(CHAR_DELTA_BLOCK, sizeof(NetCharData) - off);
+    for (size_t i = 0; i < len; ++i)
+        bytes[off + i] = data >> (8 * i);
+}
+
+uint64_t char_delta_checksum(const NetCharData& image)
+{
+    return io::snapshot_checksum(io::SNAPSHOT_CHECKSUM_INIT,
+            reinterpret_cast<const char *>(&image), sizeof(image));
+}
+
+std::vector<Packet_Repeat<0x2b17>> char_delta_diff(const NetCharData& base, const NetCharData& image)
+{
+    std::vector<Packet_Repeat<0x2b17>> rv;
+    for (size_t b = 0; b < CHAR_DELTA_BLOCKS; ++b)
+    {
+        uint64_t data = get_block(image, b);
+        if (data == get_block(base, b))
+            continue;
+        Packet_Repeat<0x2b17> block;
+        block.block = b;
+        block.data = data;
+        rv.push_back(block);
+    }
+    return rv;
+}
+
+bool char_delta_apply(NetCharData& image, const std::vector<Packet_Repeat<0x2b17>>& blocks)
+{
+    for (const Packet_Repeat<0x2b17>& block : blocks)
+    {
+        if (block.block >= CHAR_DELTA_BLOCKS)
+            return false;
+        put_block(image, block.block, block.data);
+    }
+    return true;
+}
+} // namespace tmwa
@@ -0,0 +1,44 @@
+#pragma once
+//    char_delta.hpp - Incremental character saves between map and char.
+//
+//    Copyright © 2026 The Mana World Development Team
+//
+//    This file is part of The Mana World (Athena server)
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "fwd.hpp"
+
+#include <cstdint>
+
+#include <vector>
+
+#include "../proto2/char-map.hpp"
+
+
+namespace tmwa
+{
+/// A delta save (0x2b17) is the list of 8-byte blocks of the wire image
+/// (NetCharData) that differ from the last image sent.  The checksum of
+/// that base image goes along, so the char-server can refuse the delta
+/// (0x2b18) if its copy has moved on, and the map-server sends it whole.
+constexpr size_t CHAR_DELTA_BLOCK = 8;
+constexpr size_t CHAR_DELTA_BLOCKS = (sizeof(NetCharData) + CHAR_DELTA_BLOCK - 1) / CHAR_DELTA_BLOCK;
+
+uint64_t char_delta_checksum(const NetCharData& image);
+std::vector<Packet_Repeat<0x2b17>> char_delta_diff(const NetCharData& base, const NetCharData& image);
+/// Fails, leaving `image` partly updated, if a block is out of range.
+__attribute__((warn_unused_result))
+bool char_delta_apply(NetCharData& image, const std::vector<Packet_Repeat<0x2b17>>& blocks);
+} // namespace tmwa
@@ -0,0 +1,92 @@
+#include "char_delta.hpp"
+//    high/char_delta_test.cpp - Testsuite for delta-encoded character saves
+//
+//    Copyright © 2026 The Mana World Development Team
+//
+//    This file is part of The Mana World (Athena server)
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include "../poison.hpp"
+
+
+namespace tmwa
+{
+static
+uint8_t *bytes(NetCharData& image)
+{
+    return reinterpret_cast<uint8_t *>(&image);
+}
+
+static
+void fill(NetCharData& image, uint8_t seed)
+{
+    for (size_t i = 0; i < sizeof(image); ++i)
+        bytes(image)[i] = seed + i * 7;
+}
+
+static
+bool same(NetCharData& a, NetCharData& b)
+{
+    return std::equal(bytes(a), bytes(a) + sizeof(a), bytes(b));
+}
+
+TEST(char_delta, roundtrip)
+{
+    static_assert(sizeof(NetCharData) % CHAR_DELTA_BLOCK != 0,
+            "the last block should be short");
+
+    NetCharData base, image;
+    fill(base, 1);
+    fill(image, 1);
+    bytes(image)[0] ^= 0xff;
+    bytes(image)[CHAR_DELTA_BLOCK * 5 + 3] ^= 0x10;
+    bytes(image)[sizeof(image) - 1] ^= 0x01;
+
+    std::vector<Packet_Repeat<0x2b17>> blocks = char_delta_diff(base, image);
+    ASSERT_EQ(blocks.size(), 3);
+    EXPECT_EQ(blocks[0].block, 0);
+    EXPECT_EQ(blocks[1].block, 5);
+    EXPECT_EQ(blocks[2].block, CHAR_DELTA_BLOCKS - 1);
+
+    EXPECT_NE(char_delta_checksum(base), char_delta_checksum(image));
+    EXPECT_TRUE(char_delta_apply(base, blocks));
+    EXPECT_TRUE(same(base, image));
+    EXPECT_EQ(char_delta_checksum(base), char_delta_checksum(image));
+}
+
+TEST(char_delta, identical)
+{
+    NetCharData base, image;
+    fill(base, 42);
+    fill(image, 42);
+    EXPECT_TRUE(char_delta_diff(base, image).empty());
+}
+
+TEST(char_delta, out_of_range)
+{
+    NetCharData image;
+    fill(image, 3);
+    std::vector<Packet_Repeat<0x2b17>> blocks(1);
+    blocks[0].block = CHAR_DELTA_BLOCKS;
+    blocks[0].data = 0;
+    EXPECT_FALSE(char_delta_apply(image, blocks));
+    blocks[0].block = 0xffff;
+    EXPECT_FALSE(char_delta_apply(image, blocks));
+}
+} // namespace tmwa
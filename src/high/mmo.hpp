@@ -47,11 +47,20 @@ bool operator != (const SkillValue& l, const SkillValue& r)
 struct CharPair
 {
     CharKey key;
-    std::unique_ptr<CharData> data;
+    /// Copy-on-write: copies of a CharPair (e.g. a snapshot being
+    /// written by another thread) share the data until mut().
+    std::shared_ptr<const CharData> data;
 
     CharPair()
-    : key{}, data(make_unique<CharData>())
+    : key{}, data(std::make_shared<CharData>())
     {}
+
+    CharData& mut()
+    {
+        if (data.use_count() > 1)
+            data = std::make_shared<CharData>(*data);
+        return const_cast<CharData&>(*data);
+    }
 };
 
 struct GM_Account
@@ -0,0 +1,69 @@
+#include "background.hpp"
+//    io/background.cpp - Write a file without stalling the main loop.
+//
+//    Copyright © 2026 The Mana World Development Team
+//
+//    This file is part of The Mana World (Athena server)
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <utility>
+
+#include "../poison.hpp"
+
+
+namespace tmwa
+{
+namespace io
+{
+    Background::Background()
+    : running(false), started(false)
+    {}
+    Background::~Background()
+    {
+        wait();
+    }
+
+    bool Background::start(std::function<void()> job)
+    {
+        if (running)
+            return false;
+        if (thread.joinable())
+            thread.join();
+        running = true;
+        started = true;
+        thread = std::thread([this, job]()
+                {
+                    job();
+                    running = false;
+                });
+        return true;
+    }
+
+    bool Background::done()
+    {
+        if (!started || running)
+            return false;
+        wait();
+        started = false;
+        return true;
+    }
+
+    void Background::wait()
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+} // namespace io
+} // namespace tmwa
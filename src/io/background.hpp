@@ -0,0 +1,60 @@
+#pragma once
+//    io/background.hpp - Write a file without stalling the main loop.
+//
+//    Copyright © 2026 The Mana World Development Team
+//
+//    This file is part of The Mana World (Athena server)
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "fwd.hpp"
+
+#include <atomic>
+#include <functional>
+#include <thread>
+
+
+namespace tmwa
+{
+namespace io
+{
+    /// Runs one job at a time on a thread of its own.
+    ///
+    /// The job must only touch data that it owns and that the main
+    /// thread leaves alone until done() says it has finished - in
+    /// particular no AString that the main thread can still see,
+    /// since their reference counts are not atomic.
+    class Background
+    {
+        std::thread thread;
+        std::atomic<bool> running;
+        // a job was started and done() has not said so yet
+        bool started;
+    public:
+        Background();
+        Background(Background&&) = delete;
+        Background& operator = (Background&&) = delete;
+        /// Waits for the job.
+        ~Background();
+
+        /// Fails if the last job is still running.
+        __attribute__((warn_unused_result))
+        bool start(std::function<void()> job);
+        /// True once after each job, when it has finished.
+        bool done();
+        /// Until the job (if any) has finished.
+        void wait();
+    };
+} // namespace io
+} // namespace tmwa
@@ -0,0 +1,57 @@
+#include "background.hpp"
+//    io/background_test.cpp - Testsuite for background jobs
+//
+//    Copyright © 2026 The Mana World Development Team
+//
+//    This file is part of The Mana World (Athena server)
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+
+#include "../poison.hpp"
+
+
+namespace tmwa
+{
+TEST(io, background)
+{
+    io::Background bg;
+    EXPECT_FALSE(bg.done());
+
+    std::atomic<bool> go(false);
+    int value = 0;
+    ASSERT_TRUE(bg.start([&]()
+                {
+                    while (!go)
+                        std::this_thread::yield();
+                    value = 1;
+                }));
+    EXPECT_FALSE(bg.start([]() {}));
+    EXPECT_FALSE(bg.done());
+    go = true;
+    bg.wait();
+    EXPECT_EQ(value, 1);
+    EXPECT_TRUE(bg.done());
+    EXPECT_FALSE(bg.done());
+
+    ASSERT_TRUE(bg.start([&]() { value = 2; }));
+    while (!bg.done())
+        std::this_thread::yield();
+    EXPECT_EQ(value, 2);
+    EXPECT_FALSE(bg.done());
+}
+} // namespace tmwa
@@ -109,6 +109,10 @@ namespace io
         }
         return ::close(fd);
     }
+    int FD::fdatasync()
+    {
+        return ::fdatasync(fd);
+    }
     int FD::shutdown(int how)
     {
         return ::shutdown(fd, how);
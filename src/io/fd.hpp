@@ -85,6 +85,7 @@ namespace io
         ssize_t pwritev(const struct iovec *iov, int iovcnt, off_t offset);
 
         int close();
+        int fdatasync();
         int shutdown(int);
         int getsockopt(int level, int optname, void *optval, socklen_t *optlen);
         int setsockopt(int level, int optname, const void *optval, socklen_t optlen);
@@ -36,5 +36,8 @@ namespace io
     class AppendFile;
     class LineReader;
     class LineCharReader;
+    class SnapshotReader;
+    class SnapshotWriter;
+    class Background;
 } // namespace io
 } // namespace tmwa
@@ -25,7 +25,7 @@
 #include "../strings/zstring.hpp"
 #include "../strings/literal.hpp"
 
-#include "cxxstdio.hpp"
+#include "span.hpp"
 
 #include "../poison.hpp"
 
@@ -148,13 +148,13 @@ namespace io
         if (unhappy)
         {
             if (happy)
-                FPRINTF(stderr, "warning: file contains CR\n"_fmt);
+                print_message("warning: file contains CR\n"_s);
             else
-                FPRINTF(stderr, "warning: file contains bare CR\n"_fmt);
+                print_message("warning: file contains bare CR\n"_s);
         }
         else if (!happy && anything && was_real_file)
         {
-            FPRINTF(stderr, "warning: file does not contain a trailing newline\n"_fmt);
+            print_message("warning: file does not contain a trailing newline\n"_s);
         }
         line = AString(tmp);
         return anything;
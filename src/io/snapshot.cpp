@@ -0,0 +1,209 @@
+#include "snapshot.hpp"
+//    io/snapshot.cpp - Binary snapshots of fixed-size records.
+//
+//    Copyright © 2026 The Mana World Development Team
+//
+//    This file is part of The Mana World (Athena server)
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <cassert>
+
+#include <algorithm>
+
+#include "../strings/zstring.hpp"
+#include "../strings/literal.hpp"
+
+#include "cxxstdio.hpp"
+#include "write.hpp"
+
+#include "../poison.hpp"
+
+
+namespace tmwa
+{
+namespace io
+{
+    static
+    const char snapshot_magic[8] = {'T', 'M', 'W', 'A', 'S', 'N', 'A', 'P'};
+
+    uint64_t snapshot_checksum(uint64_t hash, const char *dat, size_t len)
+    {
+        for (size_t i = 0; i < len; ++i)
+        {
+            hash ^= static_cast<uint8_t>(dat[i]);
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    SnapshotReader::SnapshotReader(ZString n)
+    : name(n), data(nullptr), len(0), mapped(false)
+    {
+        FD fd = FD::open(n, O_RDONLY | O_CLOEXEC);
+        if (fd == FD())
+            return;
+        load(fd);
+        fd.close();
+    }
+    SnapshotReader::SnapshotReader(FD fd)
+    : name("<fd>"_s), data(nullptr), len(0), mapped(false)
+    {
+        load(fd);
+    }
+    SnapshotReader::~SnapshotReader()
+    {
+        if (mapped)
+            munmap(const_cast<char *>(data), len);
+    }
+
+    void SnapshotReader::load(FD fd)
+    {
+        struct stat st;
+        if (fstat(fd.uncast_dammit(), &st) == 0
+                && S_ISREG(st.st_mode) && st.st_size > 0)
+        {
+            void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE,
+                    fd.uncast_dammit(), 0);
+            if (map != MAP_FAILED)
+            {
+                madvise(map, st.st_size, MADV_SEQUENTIAL);
+                data = static_cast<const char *>(map);
+                len = st.st_size;
+                mapped = true;
+                return;
+            }
+        }
+
+        char buf[4096];
+        ssize_t rv;
+        while ((rv = fd.read(buf, sizeof(buf))) > 0)
+            copy.insert(copy.end(), buf, buf + rv);
+        data = copy.data();
+        len = copy.size();
+    }
+
+    bool SnapshotReader::is_snapshot()
+    {
+        return len >= sizeof(snapshot_magic)
+            && std::equal(data, data + sizeof(snapshot_magic), snapshot_magic);
+    }
+
+    bool SnapshotReader::check(uint32_t kind, uint32_t version, size_t record_size)
+    {
+        if (len < sizeof(SnapshotHeader) + sizeof(SnapshotTrailer) || !is_snapshot())
+        {
+            FPRINTF(stderr, "%s: not a snapshot\n"_fmt, name);
+            return false;
+        }
+        const SnapshotHeader& head = *reinterpret_cast<const SnapshotHeader *>(data);
+        const SnapshotTrailer& tail = *reinterpret_cast<const SnapshotTrailer *>(
+                data + len - sizeof(SnapshotTrailer));
+        uint32_t file_kind, file_version, file_record_size;
+        uint64_t count, checksum;
+        if (!network_to_native(&file_kind, head.kind)
+                || !network_to_native(&file_version, head.version)
+                || !network_to_native(&file_record_size, head.record_size)
+                || !network_to_native(&count, tail.count)
+                || !network_to_native(&checksum, tail.checksum))
+            abort();
+        if (file_kind != kind)
+        {
+            FPRINTF(stderr, "%s: snapshot of the wrong kind (%08x, expected %08x)\n"_fmt,
+                    name, file_kind, kind);
+            return false;
+        }
+        if (file_version != version || file_record_size != record_size)
+        {
+            FPRINTF(stderr, "%s: snapshot version %u with %u-byte records, expected version %u with %zu-byte records\n"_fmt,
+                    name, file_version, file_record_size, version, record_size);
+            return false;
+        }
+        size_t body = len - sizeof(SnapshotHeader) - sizeof(SnapshotTrailer);
+        if (body % record_size || body / record_size != count)
+        {
+            FPRINTF(stderr, "%s: snapshot is truncated (%zu bytes for %zu records)\n"_fmt,
+                    name, body, count);
+            return false;
+        }
+        if (snapshot_checksum(SNAPSHOT_CHECKSUM_INIT, data, len - sizeof(checksum)) != checksum)
+        {
+            FPRINTF(stderr, "%s: snapshot checksum mismatch\n"_fmt, name);
+            return false;
+        }
+        return true;
+    }
+
+    size_t SnapshotReader::size()
+    {
+        const SnapshotTrailer& tail = *reinterpret_cast<const SnapshotTrailer *>(
+                data + len - sizeof(SnapshotTrailer));
+        uint64_t count;
+        if (!network_to_native(&count, tail.count))
+            abort();
+        return count;
+    }
+
+    uint64_t SnapshotReader::next_id()
+    {
+        const SnapshotHeader& head = *reinterpret_cast<const SnapshotHeader *>(data);
+        uint64_t rv;
+        if (!network_to_native(&rv, head.next_id))
+            abort();
+        return rv;
+    }
+
+    SnapshotWriter::SnapshotWriter(WriteFile& o, uint32_t kind, uint32_t version,
+            size_t rs, uint64_t next_id)
+    : out(o), hash(SNAPSHOT_CHECKSUM_INIT), count(0), record_size(rs)
+    {
+        SnapshotHeader head {};
+        std::copy(std::begin(snapshot_magic), std::end(snapshot_magic), head.magic);
+        if (!native_to_network(&head.kind, kind)
+                || !native_to_network(&head.version, version)
+                || !native_to_network(&head.record_size, uint32_t(record_size))
+                || !native_to_network(&head.next_id, next_id))
+            abort();
+        put_bytes(reinterpret_cast<const char *>(&head), sizeof(head));
+    }
+    SnapshotWriter::~SnapshotWriter()
+    {
+        Little64 net_count;
+        if (!native_to_network(&net_count, count))
+            abort();
+        put_bytes(reinterpret_cast<const char *>(&net_count), sizeof(net_count));
+        Little64 net_hash;
+        if (!native_to_network(&net_hash, hash))
+            abort();
+        out.really_put(reinterpret_cast<const char *>(&net_hash), sizeof(net_hash));
+    }
+
+    void SnapshotWriter::put_bytes(const char *dat, size_t l)
+    {
+        hash = snapshot_checksum(hash, dat, l);
+        out.really_put(dat, l);
+    }
+
+    void SnapshotWriter::put_record(const char *dat, size_t l)
+    {
+        assert (l == record_size);
+        put_bytes(dat, l);
+        count++;
+    }
+} // namespace io
+} // namespace tmwa
@@ -0,0 +1,135 @@
+#pragma once
+//    io/snapshot.hpp - Binary snapshots of fixed-size records.
+//
+//    Copyright © 2026 The Mana World Development Team
+//
+//    This file is part of The Mana World (Athena server)
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "fwd.hpp"
+
+#include <cstdint>
+
+#include <vector>
+
+#include "../ints/little.hpp"
+
+#include "../strings/astring.hpp"
+
+#include "fd.hpp"
+
+
+namespace tmwa
+{
+namespace io
+{
+    /// A snapshot is a header, a run of fixed-size records, and a trailer.
+    /// All numbers are little-endian; the checksum is 64-bit FNV-1a over
+    /// everything before it.  Records are Net* structs (alignment 1), so
+    /// loading one is a network_to_native() rather than a parse.
+    struct SnapshotHeader
+    {
+        char magic[8];
+        Little32 kind;
+        Little32 version;
+        Little32 record_size;
+        Little32 reserved;
+        /// for databases that hand out ids, the next one (%newid%)
+        Little64 next_id;
+    };
+    struct SnapshotTrailer
+    {
+        Little64 count;
+        Little64 checksum;
+    };
+
+    constexpr
+    uint32_t snapshot_kind(const char (&name)[5])
+    {
+        return uint32_t(uint8_t(name[0]))
+            | uint32_t(uint8_t(name[1])) << 8
+            | uint32_t(uint8_t(name[2])) << 16
+            | uint32_t(uint8_t(name[3])) << 24;
+    }
+
+    class SnapshotReader
+    {
+        AString name;
+        const char *data;
+        size_t len;
+        bool mapped;
+        // when the file can't be mapped (e.g. a pipe)
+        std::vector<char> copy;
+
+        void load(FD fd);
+    public:
+        explicit
+        SnapshotReader(ZString name);
+        explicit
+        SnapshotReader(FD fd);
+        SnapshotReader(SnapshotReader&&) = delete;
+        SnapshotReader& operator = (SnapshotReader&&) = delete;
+        ~SnapshotReader();
+
+        /// The file was read and starts like a snapshot.  If not, it is
+        /// missing or in the text format.
+        bool is_snapshot();
+        /// Verify the header, the length and the checksum.
+        /// On failure, says why on stderr.
+        __attribute__((warn_unused_result))
+        bool check(uint32_t kind, uint32_t version, size_t record_size);
+
+        /// Only valid after check().
+        size_t size();
+        uint64_t next_id();
+        template<class R>
+        const R& get(size_t i)
+        {
+            static_assert(alignof(R) == 1, "snapshot records are Net structs");
+            return reinterpret_cast<const R *>(data + sizeof(SnapshotHeader))[i];
+        }
+    };
+
+    /// Writes the header at once, and the trailer when destroyed,
+    /// so it must go out of scope before the WriteLock it writes to.
+    class SnapshotWriter
+    {
+        WriteFile& out;
+        uint64_t hash;
+        uint64_t count;
+        size_t record_size;
+
+        void put_bytes(const char *dat, size_t len);
+    public:
+        SnapshotWriter(WriteFile& out, uint32_t kind, uint32_t version,
+                size_t record_size, uint64_t next_id);
+        SnapshotWriter(SnapshotWriter&&) = delete;
+        SnapshotWriter& operator = (SnapshotWriter&&) = delete;
+        ~SnapshotWriter();
+
+        template<class R>
+        void put(const R& rec)
+        {
+            static_assert(alignof(R) == 1, "snapshot records are Net structs");
+            put_record(reinterpret_cast<const char *>(&rec), sizeof(R));
+        }
+        void put_record(const char *dat, size_t len);
+    };
+
+    /// 64-bit FNV-1a, continuing from `hash`.
+    uint64_t snapshot_checksum(uint64_t hash, const char *dat, size_t len);
+    constexpr uint64_t SNAPSHOT_CHECKSUM_INIT = 14695981039346656037ULL;
+} // namespace io
+} // namespace tmwa
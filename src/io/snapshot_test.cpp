@@ -0,0 +1,123 @@
+#include "snapshot.hpp"
+//    io/snapshot_test.cpp - Testsuite for binary snapshots
+//
+//    Copyright © 2026 The Mana World Development Team
+//
+//    This file is part of The Mana World (Athena server)
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include "../strings/literal.hpp"
+
+#include "write.hpp"
+
+#include "../tests/fdhack.hpp"
+
+#include "../poison.hpp"
+
+
+namespace tmwa
+{
+struct NetTestRecord
+{
+    Little32 id;
+    Little16 value;
+};
+
+constexpr uint32_t TEST_KIND = io::snapshot_kind("TEST");
+
+static
+void write_snapshot(io::FD wfd, int n)
+{
+    io::WriteFile wf(wfd);
+    io::SnapshotWriter snap(wf, TEST_KIND, 1, sizeof(NetTestRecord), 42);
+    for (int i = 0; i < n; ++i)
+    {
+        NetTestRecord r;
+        EXPECT_TRUE(native_to_network(&r.id, uint32_t(i * 1000)));
+        EXPECT_TRUE(native_to_network(&r.value, uint16_t(i)));
+        snap.put(r);
+    }
+}
+
+TEST(io, snapshot_roundtrip)
+{
+    io::FD rfd, wfd;
+    ASSERT_NE(-1, io::FD::pipe(rfd, wfd));
+    write_snapshot(wfd, 3);
+    io::SnapshotReader snap(rfd);
+    rfd.close();
+    EXPECT_TRUE(snap.is_snapshot());
+    ASSERT_TRUE(snap.check(TEST_KIND, 1, sizeof(NetTestRecord)));
+    EXPECT_EQ(snap.size(), 3);
+    EXPECT_EQ(snap.next_id(), 42);
+    for (size_t i = 0; i < 3; ++i)
+    {
+        uint32_t id;
+        uint16_t value;
+        EXPECT_TRUE(network_to_native(&id, snap.get<NetTestRecord>(i).id));
+        EXPECT_TRUE(network_to_native(&value, snap.get<NetTestRecord>(i).value));
+        EXPECT_EQ(id, i * 1000);
+        EXPECT_EQ(value, i);
+    }
+}
+
+TEST(io, snapshot_mismatch)
+{
+    QuietFd q;
+    io::FD rfd, wfd;
+    ASSERT_NE(-1, io::FD::pipe(rfd, wfd));
+    write_snapshot(wfd, 1);
+    io::SnapshotReader snap(rfd);
+    rfd.close();
+    EXPECT_FALSE(snap.check(io::snapshot_kind("TSET"), 1, sizeof(NetTestRecord)));
+    EXPECT_FALSE(snap.check(TEST_KIND, 2, sizeof(NetTestRecord)));
+    EXPECT_FALSE(snap.check(TEST_KIND, 1, sizeof(NetTestRecord) + 1));
+    EXPECT_TRUE(snap.check(TEST_KIND, 1, sizeof(NetTestRecord)));
+}
+
+TEST(io, snapshot_text)
+{
+    io::FD rfd, wfd;
+    ASSERT_NE(-1, io::FD::pipe(rfd, wfd));
+    ZString text = "150000\t2000000,0\tAlicia\n"_s;
+    ASSERT_EQ(text.size(), wfd.write(text.c_str(), text.size()));
+    wfd.close();
+    io::SnapshotReader snap(rfd);
+    rfd.close();
+    EXPECT_FALSE(snap.is_snapshot());
+}
+
+TEST(io, snapshot_corrupt)
+{
+    QuietFd q;
+    io::FD rfd, wfd, rfd2, wfd2;
+    ASSERT_NE(-1, io::FD::pipe(rfd, wfd));
+    ASSERT_NE(-1, io::FD::pipe(rfd2, wfd2));
+    write_snapshot(wfd, 2);
+    char buf[4096];
+    ssize_t n = rfd.read(buf, sizeof(buf));
+    rfd.close();
+    ASSERT_GT(n, 0);
+    buf[sizeof(io::SnapshotHeader) + 1] ^= 1;
+    ASSERT_EQ(n, wfd2.write(buf, n));
+    wfd2.close();
+    io::SnapshotReader snap(rfd2);
+    rfd2.close();
+    EXPECT_TRUE(snap.is_snapshot());
+    EXPECT_FALSE(snap.check(TEST_KIND, 1, sizeof(NetTestRecord)));
+}
+} // namespace tmwa
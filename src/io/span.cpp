@@ -31,6 +31,22 @@ namespace tmwa
 {
 namespace io
 {
+    static thread_local
+    MString *message_capture = nullptr;
+
+    void capture_messages(MString *buf)
+    {
+        message_capture = buf;
+    }
+
+    void print_message(ZString msg)
+    {
+        if (message_capture)
+            *message_capture += msg;
+        else
+            FPRINTF(stderr, "%s"_fmt, msg);
+    }
+
     AString Line::message_str(ZString cat, ZString msg) const
     {
         MString out;
@@ -47,14 +63,7 @@ namespace io
 
     void Line::message(ZString cat, ZString msg) const
     {
-        if (column)
-            FPRINTF(stderr, "%s:%u:%u: %s: %s\n"_fmt,
-                    filename, line, column, cat, msg);
-        else
-            FPRINTF(stderr, "%s:%u: %s: %s\n"_fmt,
-                    filename, line, cat, msg);
-        FPRINTF(stderr, "%s\n"_fmt, text);
-        FPRINTF(stderr, "%*c\n"_fmt, column, '^');
+        print_message(message_str(cat, msg));
     }
 
     AString LineSpan::message_str(ZString cat, ZString msg) const
@@ -93,7 +102,7 @@ namespace io
 
     void LineSpan::message(ZString cat, ZString msg) const
     {
-        FPRINTF(stderr, "%s"_fmt, message_str(cat, msg));
+        print_message(message_str(cat, msg));
     }
 } // namespace io
 } // namespace tmwa
@@ -29,6 +29,13 @@ namespace tmwa
 {
 namespace io
 {
+    /// Line and LineSpan messages normally go straight to stderr.
+    /// While a buffer is set, the calling thread appends them to it
+    /// instead, so a parse done off the main thread can be replayed
+    /// in order.  Pass nullptr to go back to stderr.
+    void capture_messages(MString *buf);
+    void print_message(ZString msg);
+
     // TODO split this out
     struct Line
     {
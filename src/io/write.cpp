@@ -140,7 +140,7 @@ namespace io
             put('\n');
     }
 
-    bool WriteFile::close()
+    bool WriteFile::flush()
     {
         size_t off = 0;
         while (off < buflen)
@@ -154,6 +154,21 @@ namespace io
             }
             off += rv;
         }
+        buflen = 0;
+        return true;
+    }
+
+    bool WriteFile::sync()
+    {
+        if (!flush())
+            return false;
+        return fd.fdatasync() == 0;
+    }
+
+    bool WriteFile::close()
+    {
+        if (!flush())
+            return false;
 
         FD f = fd;
         fd = FD();
@@ -52,6 +52,12 @@ namespace io
         void really_put(const char *dat, size_t len);
         void put_line(XString);
 
+        /// Write out the buffer, keeping the file open.
+        __attribute__((warn_unused_result))
+        bool flush();
+        /// flush(), then wait for the data to reach the disk.
+        __attribute__((warn_unused_result))
+        bool sync();
         __attribute__((warn_unused_result))
         bool close();
         bool is_open();
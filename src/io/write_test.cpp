@@ -105,6 +105,20 @@ TEST(io, write2)
     EXPECT_EQ("XXX"_s, pw.slurp());
 }
 
+TEST(io, write_flush)
+{
+    PipeWriter pw(false);
+    io::WriteFile& wf = pw.wf;
+    wf.put_line("Hello"_s);
+    EXPECT_EQ(""_s, pw.slurp());
+    EXPECT_TRUE(wf.flush());
+    EXPECT_EQ("Hello\n"_s, pw.slurp());
+    EXPECT_TRUE(wf.is_open());
+    wf.put_line("World"_s);
+    EXPECT_TRUE(wf.close());
+    EXPECT_EQ("World\n"_s, pw.slurp());
+}
+
 TEST(io, write3)
 {
     // TODO see if it's possible to get the real value
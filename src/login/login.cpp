@@ -21,20 +21,22 @@
 //    You should have received a copy of the GNU General Public License
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
-#include <sys/wait.h>
 
 #include <netdb.h>
 #include <unistd.h>
 
-#include <sys/resource.h>
-
 #include <ctime>
 
 #include <algorithm>
+#include <chrono>
+#include <memory>
 #include <set>
+#include <unordered_map>
 
 #include "../ints/udl.hpp"
 
+#include "../range/slice.hpp"
+
 #include "../strings/mstring.hpp"
 #include "../strings/astring.hpp"
 #include "../strings/zstring.hpp"
@@ -45,9 +47,11 @@
 #include "../generic/random.hpp"
 
 #include "../io/cxxstdio.hpp"
+#include "../io/background.hpp"
 #include "../io/extract.hpp"
 #include "../io/lock.hpp"
 #include "../io/read.hpp"
+#include "../io/snapshot.hpp"
 #include "../io/tty.hpp"
 #include "../io/write.hpp"
 
@@ -125,6 +129,10 @@ ServerName main_server;
 
 static
 AString account_filename = "save/account.txt"_s;
+// write account_filename as a binary snapshot instead of text
+// (reading accepts either)
+static
+bool binary_snapshots = false;
 static
 AString gm_account_filename = "save/gm_account.txt"_s;
 static
@@ -225,6 +233,34 @@ struct AuthData
 static
 std::vector<AuthData> auth_data;
 
+struct AccountNameHash
+{
+    size_t operator()(const AccountName& name) const
+    {
+        // FNV-1a
+        size_t h = 14695981039346656037ULL;
+        for (char c : name)
+        {
+            h ^= static_cast<uint8_t>(c);
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+};
+struct AccountIdHash
+{
+    size_t operator()(AccountId id) const
+    {
+        return std::hash<uint32_t>()(unwrap<AccountId>(id));
+    }
+};
+// Positions in auth_data, which only grows (deleted accounts are
+// blanked in place).  Only auth_insert and auth_erase touch them.
+static
+std::unordered_map<AccountName, size_t, AccountNameHash> auth_by_name;
+static
+std::unordered_map<AccountId, size_t, AccountIdHash> auth_by_id;
+
 static
 int admin_state = 0;
 static
@@ -238,9 +274,6 @@ GmLevel level_new_gm = GmLevel::from(60u);
 static
 Map<AccountId, GM_Account> gm_account_db;
 
-static
-pid_t pid = 0; // For forked DB writes
-
 
 //------------------------------
 // Writing function of logs file
@@ -441,15 +474,55 @@ bool check_ladminip(IP4Address ip)
 static
 AuthData *search_account(AccountName account_name)
 {
-    for (AuthData& ad : auth_data)
-    {
-        {
-            if (ad.userid == account_name)
-                return &ad;
-        }
-    }
+    auto it = auth_by_name.find(account_name);
+    if (it == auth_by_name.end())
+        return nullptr;
+    return &auth_data[it->second];
+}
+
+static
+AuthData *search_account_id(AccountId account_id)
+{
+    auto it = auth_by_id.find(account_id);
+    if (it == auth_by_id.end())
+        return nullptr;
+    return &auth_data[it->second];
+}
 
-    return nullptr;
+// The account with that id, as a range of zero or one element,
+// for the handlers written as a loop over auth_data.
+static
+Slice<AuthData> account_with_id(AccountId account_id)
+{
+    AuthData *ad = search_account_id(account_id);
+    return Slice<AuthData>(ad, ad ? 1 : 0);
+}
+
+//-----------------------------------------------
+// Add an account and index it
+//   (the name and id must not be in use)
+//-----------------------------------------------
+static
+AuthData *auth_insert(const AuthData& ad)
+{
+    size_t pos = auth_data.size();
+    auth_data.push_back(ad);
+    auth_by_name.insert({ad.userid, pos});
+    auth_by_id.insert({ad.account_id, pos});
+    return &auth_data.back();
+}
+
+//-----------------------------------------------
+// Delete an account
+//   (the entry is kept, with no name and no id)
+//-----------------------------------------------
+static
+void auth_erase(AuthData *ad)
+{
+    auth_by_name.erase(ad->userid);
+    auth_by_id.erase(ad->account_id);
+    ad->userid = AccountName();
+    ad->account_id = AccountId();
 }
 
 //--------------------------------------------------------
@@ -571,6 +644,141 @@ bool extract(XString line, AuthData *ad)
     return true;
 }
 
+// An account in a binary snapshot of account_filename.
+struct NetAuthData
+{
+    Little32 account_id;
+    Byte sex;
+    NetString<sizeof(AccountName)> userid;
+    NetString<sizeof(AccountCrypt)> pass;
+    NetString<sizeof(timestamp_milliseconds_buffer)> lastlogin;
+    Little32 logincount;
+    Little32 state;
+    NetString<sizeof(AccountEmail)> email;
+    NetString<sizeof(timestamp_seconds_buffer)> error_message;
+    Little64 ban_until_time;
+    Little64 connect_until_time;
+    IP4Address last_ip;
+    NetString<sizeof(VString<254>)> memo;
+    Little32 account_reg2_num;
+    NetArray<NetGlobalReg, ACCOUNT_REG2_NUM> account_reg2;
+};
+static_assert(alignof(NetAuthData) == 1, "alignof(NetAuthData) == 1");
+constexpr uint32_t AUTH_SNAPSHOT_KIND = io::snapshot_kind("ACCT");
+constexpr uint32_t AUTH_SNAPSHOT_VERSION = 1;
+
+static __attribute__((warn_unused_result))
+bool native_to_network(NetAuthData *network, const AuthData& native)
+{
+    bool rv = true;
+    rv &= native_to_network(&network->account_id, native.account_id);
+    rv &= native_to_network(&network->sex, native.sex);
+    rv &= native_to_network(&network->userid, native.userid);
+    rv &= native_to_network(&network->pass, native.pass);
+    rv &= native_to_network(&network->lastlogin, native.lastlogin);
+    rv &= native_to_network(&network->logincount, static_cast<uint32_t>(native.logincount));
+    rv &= native_to_network(&network->state, static_cast<uint32_t>(native.state));
+    rv &= native_to_network(&network->email, native.email);
+    rv &= native_to_network(&network->error_message, native.error_message);
+    rv &= native_to_network(&network->ban_until_time, native.ban_until_time);
+    rv &= native_to_network(&network->connect_until_time, native.connect_until_time);
+    rv &= native_to_network(&network->last_ip, native.last_ip);
+    rv &= native_to_network(&network->memo, native.memo);
+    rv &= native_to_network(&network->account_reg2_num, static_cast<uint32_t>(native.account_reg2_num));
+    rv &= native_to_network(&network->account_reg2, native.account_reg2);
+    return rv;
+}
+static __attribute__((warn_unused_result))
+bool network_to_native(AuthData *native, const NetAuthData& network)
+{
+    bool rv = true;
+    uint32_t logincount, state, account_reg2_num;
+    rv &= network_to_native(&native->account_id, network.account_id);
+    rv &= network_to_native(&native->sex, network.sex);
+    rv &= network_to_native(&native->userid, network.userid);
+    rv &= network_to_native(&native->pass, network.pass);
+    rv &= network_to_native(&native->lastlogin, network.lastlogin);
+    rv &= network_to_native(&logincount, network.logincount);
+    rv &= network_to_native(&state, network.state);
+    rv &= network_to_native(&native->email, network.email);
+    rv &= network_to_native(&native->error_message, network.error_message);
+    rv &= network_to_native(&native->ban_until_time, network.ban_until_time);
+    rv &= network_to_native(&native->connect_until_time, network.connect_until_time);
+    rv &= network_to_native(&native->last_ip, network.last_ip);
+    rv &= network_to_native(&native->memo, network.memo);
+    rv &= network_to_native(&account_reg2_num, network.account_reg2_num);
+    rv &= network_to_native(&native->account_reg2, network.account_reg2);
+    native->logincount = logincount;
+    native->state = state;
+    native->account_reg2_num = account_reg2_num;
+    rv &= account_reg2_num <= ACCOUNT_REG2_NUM;
+    return rv;
+}
+
+static
+void mmo_auth_load(const AuthData& ad, int *gm_count)
+{
+    auth_insert(ad);
+
+    if (isGM(ad.account_id))
+        ++*gm_count;
+
+    if (account_id_count < next(ad.account_id))
+        account_id_count = next(ad.account_id);
+}
+
+static
+void mmo_auth_read_snapshot(io::SnapshotReader& snap, int *gm_count)
+{
+    if (!snap.check(AUTH_SNAPSHOT_KIND, AUTH_SNAPSHOT_VERSION, sizeof(NetAuthData)))
+    {
+        PRINTF(SGR_BOLD SGR_RED "mmo_auth_init: Accounts file [%s] is damaged." SGR_RESET "\n"_fmt,
+                account_filename);
+        exit(1);
+    }
+    AccountId next_id = wrap<AccountId>(static_cast<uint32_t>(snap.next_id()));
+    if (account_id_count < next_id)
+        account_id_count = next_id;
+    for (size_t i = 0, n = snap.size(); i < n; ++i)
+    {
+        AuthData ad {};
+        if (network_to_native(&ad, snap.get<NetAuthData>(i)) && ad.account_id)
+            mmo_auth_load(ad, gm_count);
+        else
+            LOGIN_LOG("Account skipped (record %zu)\n"_fmt, i);
+    }
+}
+
+// A copy of the accounts, for writing account_filename off the main
+// thread.  AuthData is a plain value, so the copy shares nothing.
+struct AuthSnapshot
+{
+    AString filename;
+    bool binary;
+    AccountId next_id;
+    std::vector<AuthData> accounts;
+
+    // filled in by mmo_auth_write
+    bool written = false;
+    std::vector<AccountId> not_saved;
+    std::chrono::steady_clock::duration copy_time, write_time;
+};
+
+static
+void mmo_auth_write_snapshot(io::WriteFile& fp, AuthSnapshot& as)
+{
+    io::SnapshotWriter snap(fp, AUTH_SNAPSHOT_KIND, AUTH_SNAPSHOT_VERSION,
+            sizeof(NetAuthData), unwrap<AccountId>(as.next_id));
+    for (const AuthData& ad : as.accounts)
+    {
+        NetAuthData rec;
+        if (native_to_network(&rec, ad))
+            snap.put(rec);
+        else
+            as.not_saved.push_back(ad.account_id);
+    }
+}
+
 //---------------------------------
 // Reading of the accounts database
 //---------------------------------
@@ -579,6 +787,17 @@ int mmo_auth_init(void)
 {
     int gm_count = 0;
 
+    {
+        io::SnapshotReader snap(account_filename);
+        if (snap.is_snapshot())
+        {
+            mmo_auth_read_snapshot(snap, &gm_count);
+            PRINTF("mmo_auth_init: %s has %zu accounts (%d GMs)\n"_fmt,
+                    account_filename, auth_data.size(), gm_count);
+            return 0;
+        }
+    }
+
     io::ReadFile in(account_filename);
     if (!in.is_open())
     {
@@ -612,13 +831,7 @@ int mmo_auth_init(void)
             continue;
         }
 
-        auth_data.push_back(ad);
-
-        if (isGM(ad.account_id))
-            gm_count++;
-
-        if (account_id_count < next(ad.account_id))
-            account_id_count = next(ad.account_id);
+        mmo_auth_load(ad, &gm_count);
     }
 
     AString str = STRPRINTF("%s has %zu accounts (%d GMs)\n"_fmt,
@@ -631,47 +844,118 @@ int mmo_auth_init(void)
 
 //------------------------------------------
 // Writing of the accounts database file
+//   The accounts are copied on the main thread and written
+//   by auth_sync_worker (or at once, by mmo_auth_sync).
 //------------------------------------------
 static
-void mmo_auth_sync(void)
+io::Background auth_sync_worker;
+// the snapshot auth_sync_worker is writing
+static
+std::unique_ptr<AuthSnapshot> auth_sync_job;
+
+static
+std::unique_ptr<AuthSnapshot> mmo_auth_snapshot(void)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto as = make_unique<AuthSnapshot>();
+    as->filename = AString(account_filename.begin(), account_filename.end());
+    as->binary = binary_snapshots;
+    as->next_id = account_id_count;
+    as->accounts.reserve(auth_data.size());
+    for (const AuthData& ad : auth_data)
+    {
+        if (ad.account_id)
+            as->accounts.push_back(ad);
+    }
+    as->copy_time = std::chrono::steady_clock::now() - start;
+    return as;
+}
+
+// Runs on either thread; touches nothing but as.
+static
+void mmo_auth_write(AuthSnapshot& as)
 {
-    io::WriteLock fp(account_filename);
+    auto start = std::chrono::steady_clock::now();
+    {
+        io::WriteLock fp(as.filename);
 
-    if (!fp.is_open())
+        if (!fp.is_open())
+            return;
+        if (as.binary)
+            mmo_auth_write_snapshot(fp, as);
+        else
+        {
+            FPRINTF(fp,
+                    "// Accounts file: here are saved all information about the accounts.\n"_fmt);
+            FPRINTF(fp,
+                    "// Structure: ID, account name, password, last login time, sex, # of logins, state, email, error message for state 7, validity time, last (accepted) login ip, memo field, ban timestamp, repeated(register text, register value)\n"_fmt);
+            FPRINTF(fp, "// Some explanations:\n"_fmt);
+            FPRINTF(fp,
+                    "//   account name    : between 4 to 23 char for a normal account (standard client can't send less than 4 char).\n"_fmt);
+            FPRINTF(fp, "//   account password: between 4 to 23 char\n"_fmt);
+            FPRINTF(fp,
+                    "//   sex             : M or F for normal accounts, S for server accounts\n"_fmt);
+            FPRINTF(fp,
+                    "//   state           : 0: account is ok, 1 to 256: error code of packet 0x006a + 1\n"_fmt);
+            FPRINTF(fp,
+                    "//   email           : between 3 to 39 char (a@a.com is like no email)\n"_fmt);
+            FPRINTF(fp,
+                    "//   error message   : text for the state 7: 'Your are Prohibited to login until <text>'. Max 19 char\n"_fmt);
+            FPRINTF(fp,
+                    "//   valitidy time   : 0: unlimited account, <other value>: date calculated by addition of 1/1/1970 + value (number of seconds since the 1/1/1970)\n"_fmt);
+            FPRINTF(fp, "//   memo field      : max 254 char\n"_fmt);
+            FPRINTF(fp,
+                    "//   ban time        : 0: no ban, <other value>: banned until the date: date calculated by addition of 1/1/1970 + value (number of seconds since the 1/1/1970)\n"_fmt);
+            for (const AuthData& ad : as.accounts)
+            {
+                AString line = mmo_auth_tostr(&ad);
+                fp.put_line(line);
+            }
+            FPRINTF(fp, "%d\t%%newid%%\n"_fmt, as.next_id);
+        }
+    }
+    as.written = true;
+    as.write_time = std::chrono::steady_clock::now() - start;
+}
+
+// Back on the main thread, after mmo_auth_write.
+static
+void mmo_auth_sync_finish(AuthSnapshot& as)
+{
+    namespace c = std::chrono;
+    if (!as.written)
     {
         PRINTF("uh-oh - unable to save accounts\n"_fmt);
         return;
     }
-    FPRINTF(fp,
-            "// Accounts file: here are saved all information about the accounts.\n"_fmt);
-    FPRINTF(fp,
-            "// Structure: ID, account name, password, last login time, sex, # of logins, state, email, error message for state 7, validity time, last (accepted) login ip, memo field, ban timestamp, repeated(register text, register value)\n"_fmt);
-    FPRINTF(fp, "// Some explanations:\n"_fmt);
-    FPRINTF(fp,
-            "//   account name    : between 4 to 23 char for a normal account (standard client can't send less than 4 char).\n"_fmt);
-    FPRINTF(fp, "//   account password: between 4 to 23 char\n"_fmt);
-    FPRINTF(fp,
-            "//   sex             : M or F for normal accounts, S for server accounts\n"_fmt);
-    FPRINTF(fp,
-            "//   state           : 0: account is ok, 1 to 256: error code of packet 0x006a + 1\n"_fmt);
-    FPRINTF(fp,
-            "//   email           : between 3 to 39 char (a@a.com is like no email)\n"_fmt);
-    FPRINTF(fp,
-            "//   error message   : text for the state 7: 'Your are Prohibited to login until <text>'. Max 19 char\n"_fmt);
-    FPRINTF(fp,
-            "//   valitidy time   : 0: unlimited account, <other value>: date calculated by addition of 1/1/1970 + value (number of seconds since the 1/1/1970)\n"_fmt);
-    FPRINTF(fp, "//   memo field      : max 254 char\n"_fmt);
-    FPRINTF(fp,
-            "//   ban time        : 0: no ban, <other value>: banned until the date: date calculated by addition of 1/1/1970 + value (number of seconds since the 1/1/1970)\n"_fmt);
-    for (const AuthData& ad : auth_data)
-    {
-        if (!ad.account_id)
-            continue;
+    for (AccountId account_id : as.not_saved)
+        LOGIN_LOG("Account not saved: %d\n"_fmt, account_id);
+    LOGIN_LOG("mmo_auth_sync: %zu accounts, %ld ms to copy, %ld ms to write.\n"_fmt,
+            as.accounts.size(),
+            c::duration_cast<c::milliseconds>(as.copy_time).count(),
+            c::duration_cast<c::milliseconds>(as.write_time).count());
+}
 
-        AString line = mmo_auth_tostr(&ad);
-        fp.put_line(line);
+static
+void mmo_auth_sync_poll(void)
+{
+    if (auth_sync_job && auth_sync_worker.done())
+    {
+        mmo_auth_sync_finish(*auth_sync_job);
+        auth_sync_job.reset();
     }
-    FPRINTF(fp, "%d\t%%newid%%\n"_fmt, account_id_count);
+}
+
+/// Write account_filename now, after any write still running.
+static
+void mmo_auth_sync(void)
+{
+    auth_sync_worker.wait();
+    mmo_auth_sync_poll();
+
+    std::unique_ptr<AuthSnapshot> as = mmo_auth_snapshot();
+    mmo_auth_write(*as);
+    mmo_auth_sync_finish(*as);
 }
 
 // We want to sync the DB to disk as little as possible as it's fairly
@@ -682,34 +966,17 @@ void mmo_auth_sync(void)
 static
 void check_auth_sync(TimerData *, tick_t)
 {
-    if (pid != 0)
-    {
-        int status;
-        pid_t temp = waitpid(pid, &status, WNOHANG);
-
-        // Need to check status too?
-        if (temp == 0)
-        {
-            return;
-        }
-    }
-
-    // This can take a lot of time. Fork a child to handle the work and return at once
-    // If we're unable to fork just continue running the function normally
-    if ((pid = fork()) > 0)
+    // This can take a lot of time; copy the accounts, write them on
+    // another thread and return at once.  Skip a turn if the last
+    // write is not done yet.
+    mmo_auth_sync_poll();
+    if (auth_sync_job)
         return;
 
-    // If we're a child, run as a lower priority process
-    if (pid == 0)
-        setpriority(PRIO_PROCESS, getpid(), 10);
-
-    mmo_auth_sync();
-
-    // If we're a child we should suicide now.
-    if (pid == 0)
-        _exit(0);
-
-    return;
+    auth_sync_job = mmo_auth_snapshot();
+    AuthSnapshot *as = auth_sync_job.get();
+    if (!auth_sync_worker.start([as]() { mmo_auth_write(*as); }))
+        abort();
 }
 
 
@@ -811,7 +1078,7 @@ AccountId mmo_auth_new(struct mmo_account *account, SEX sex, AccountEmail email)
     ad.last_ip = IP4Address();
     ad.memo = "!"_s;
     ad.account_reg2_num = 0;
-    auth_data.push_back(ad);
+    auth_insert(ad);
 
     return ad.account_id;
 }
@@ -1036,7 +1303,7 @@ void parse_fromchar(Session *s)
                             auth_fifo[i].delflag = 1;
                             LOGIN_LOG("Char-server '%s': authentification of the account %d accepted (ip: %s).\n"_fmt,
                                     server[id].name, acc, ip);
-                            for (const AuthData& ad : auth_data)
+                            for (const AuthData& ad : account_with_id(acc))
                             {
                                 if (ad.account_id == acc)
                                 {
@@ -1108,7 +1375,7 @@ void parse_fromchar(Session *s)
                     break;
 
                 AccountId account_id = fixed.account_id;
-                for (const AuthData& ad : auth_data)
+                for (const AuthData& ad : account_with_id(account_id))
                 {
                     if (ad.account_id == account_id)
                     {
@@ -1242,7 +1509,7 @@ void parse_fromchar(Session *s)
                                 server[id].name, acc, ip);
                     else
                     {
-                        for (AuthData& ad : auth_data)
+                        for (AuthData& ad : account_with_id(acc))
                         {
                             if (ad.account_id == acc)
                             {
@@ -1280,7 +1547,7 @@ void parse_fromchar(Session *s)
                 {
                     AccountId acc = fixed.account_id;
                     int statut = fixed.status;
-                    for (AuthData& ad : auth_data)
+                    for (AuthData& ad : account_with_id(acc))
                     {
                         if (ad.account_id == acc)
                         {
@@ -1333,7 +1600,7 @@ void parse_fromchar(Session *s)
 
                 {
                     AccountId acc = fixed.account_id;
-                    for (AuthData& ad : auth_data)
+                    for (AuthData& ad : account_with_id(acc))
                     {
                         if (ad.account_id == acc)
                         {
@@ -1424,7 +1691,7 @@ void parse_fromchar(Session *s)
 
                 {
                     AccountId acc = fixed.account_id;
-                    for (AuthData& ad : auth_data)
+                    for (AuthData& ad : account_with_id(acc))
                     {
                         if (ad.account_id == acc)
                         {
@@ -1475,7 +1742,7 @@ void parse_fromchar(Session *s)
 
                 {
                     AccountId acc = head.account_id;
-                    for (AuthData& ad : auth_data)
+                    for (AuthData& ad : account_with_id(acc))
                     {
                         if (ad.account_id == acc)
                         {
@@ -1525,7 +1792,7 @@ void parse_fromchar(Session *s)
 
                 {
                     AccountId acc = fixed.account_id;
-                    for (AuthData& ad : auth_data)
+                    for (AuthData& ad : account_with_id(acc))
                     {
                         if (ad.account_id == acc)
                         {
@@ -1566,7 +1833,7 @@ void parse_fromchar(Session *s)
 
                     int status = 0;
 
-                    for (AuthData& ad : auth_data)
+                    for (AuthData& ad : account_with_id(acc))
                     {
                         if (ad.account_id == acc)
                         {
@@ -1772,14 +2039,11 @@ void parse_admin(Session *s)
                     }
                     else
                     {
-                        for (const AuthData& ad : auth_data)
+                        if (search_account(ma.userid))
                         {
-                            if (ad.userid == ma.userid)
-                            {
-                                LOGIN_LOG("'ladmin': Attempt to create an already existing account (account: %s ip: %s)\n"_fmt,
-                                        ad.userid, ip);
-                                goto x7930_out;
-                            }
+                            LOGIN_LOG("'ladmin': Attempt to create an already existing account (account: %s ip: %s)\n"_fmt,
+                                    ma.userid, ip);
+                            goto x7930_out;
                         }
                         {
                             AccountEmail email = fixed.email;
@@ -1830,8 +2094,7 @@ void parse_admin(Session *s)
                         LOGIN_LOG("%s\n"_fmt, buf2);
                     }
                     // delete account
-                    ad->userid = AccountName();
-                    ad->account_id = AccountId();
+                    auth_erase(ad);
                 }
                 else
                 {
@@ -2314,7 +2577,7 @@ void parse_admin(Session *s)
                 Packet_Fixed<0x7947> fixed_47;
                 fixed_47.account_id = account_id;
                 fixed_47.account_name = {};
-                for (const AuthData& ad : auth_data)
+                for (const AuthData& ad : account_with_id(account_id))
                 {
                     if (ad.account_id == account_id)
                     {
@@ -2732,7 +2995,7 @@ void parse_admin(Session *s)
                 Packet_Head<0x7953> head_53;
                 head_53.account_id = account_id;
                 head_53.account_name = AccountName();
-                for (const AuthData& ad : auth_data)
+                for (const AuthData& ad : account_with_id(account_id))
                 {
                     if (ad.account_id == account_id)
                     {
@@ -3361,6 +3624,10 @@ bool login_config(XString w1, ZString w2)
         {
             account_filename = w2;
         }
+        else if (w1 == "binary_snapshots"_s)
+        {
+            binary_snapshots = config_switch(w2);
+        }
         else if (w1 == "gm_account_filename"_s)
         {
             gm_account_filename = w2;
@@ -3859,6 +4126,8 @@ void term_func(void)
 {
     mmo_auth_sync();
 
+    auth_by_name.clear();
+    auth_by_id.clear();
     auth_data.clear();
     gm_account_db.clear();
     for (int i = 0; i < MAX_SERVERS; i++)
@@ -3890,6 +4159,7 @@ int do_init(Slice<ZString> argv)
 {
     ZString argv0 = argv.pop_front();
     bool loaded_config_yet = false;
+    Option<bool> convert_to_binary = None;
     while (argv)
     {
         ZString argvi = argv.pop_front();
@@ -3897,8 +4167,10 @@ int do_init(Slice<ZString> argv)
         {
             if (argvi == "--help"_s)
             {
-                PRINTF("Usage: %s [--help] [--version] [files...]\n"_fmt,
+                PRINTF("Usage: %s [--help] [--version] [--convert-text | --convert-binary] [files...]\n"_fmt,
                         argv0);
+                PRINTF("  --convert-text, --convert-binary: rewrite the accounts file\n"_fmt);
+                PRINTF("    in that format, then exit\n"_fmt);
                 exit(0);
             }
             else if (argvi == "--version"_s)
@@ -3906,6 +4178,14 @@ int do_init(Slice<ZString> argv)
                 PRINTF("%s\n"_fmt, CURRENT_VERSION_STRING);
                 exit(0);
             }
+            else if (argvi == "--convert-text"_s)
+            {
+                convert_to_binary = Some(false);
+            }
+            else if (argvi == "--convert-binary"_s)
+            {
+                convert_to_binary = Some(true);
+            }
             else
             {
                 FPRINTF(stderr, "Unknown argument: %s\n"_fmt, argvi);
@@ -3922,6 +4202,19 @@ int do_init(Slice<ZString> argv)
     if (!loaded_config_yet)
         runflag &= load_config_file("conf/tmwa-login.conf"_s, login_confs);
 
+    if OPTION_IS_SOME(binary, convert_to_binary)
+    {
+        if (!runflag)
+            exit(1);
+        binary_snapshots = binary;
+        read_gm_account();
+        mmo_auth_init();
+        mmo_auth_sync();
+        PRINTF("Converted %s to %s.\n"_fmt, account_filename,
+                binary ? "a binary snapshot"_s : "text"_s);
+        exit(0);
+    }
+
     // not in login_config_read, because we can use 'import' option, and display same message twice or more
     // (why is that bad?)
     runflag &= display_conf_warnings();
@@ -70,6 +70,7 @@
 #include "npc-parse.hpp"
 #include "party.hpp"
 #include "pc.hpp"
+#include "script-profile.hpp"
 #include "skill.hpp"
 #include "storage.hpp"
 #include "tmw.hpp"
@@ -3670,6 +3671,74 @@ ATCE atcommand_servertime(Session *s, dumb_ptr<map_session_data>,
     return ATCE::OKAY;
 }
 
+static
+ATCE atcommand_mobsleep(Session *s, dumb_ptr<map_session_data>,
+        ZString)
+{
+    const Mob_Sleep_Stats& stats = mob_sleep_stats;
+    double uptime = std::chrono::duration<double>(gettick() - stats.since).count();
+    if (uptime < 1)
+        uptime = 1;
+
+    AString output = STRPRINTF("Monster sleep is %s."_fmt,
+            battle_config.mob_lazy_sleep ? "on"_s : "off"_s);
+    clif_displaymessage(s, output);
+    output = STRPRINTF("%ld sleeps, %ld wake-ups (%.2f per second)."_fmt,
+            stats.sleeps, stats.wakeups, stats.wakeups / uptime);
+    clif_displaymessage(s, output);
+    output = STRPRINTF("Skipped %ld lazy AI passes and %ld walk decisions; replayed %ld moves on waking."_fmt,
+            stats.lazy_skips, stats.walk_decisions_skipped, stats.catchup_moves);
+    clif_displaymessage(s, output);
+
+    return ATCE::OKAY;
+}
+
+static
+ATCE atcommand_scriptprofile(Session *s, dumb_ptr<map_session_data>,
+        ZString message)
+{
+    if (message == "on"_s)
+    {
+        battle_config.script_profile = 1;
+    }
+    else if (message == "off"_s)
+    {
+        battle_config.script_profile = 0;
+    }
+    else if (message == "reset"_s)
+    {
+        script_profile_reset();
+    }
+    else if (message == "dump"_s)
+    {
+        script_profile_dump();
+        clif_displaymessage(s, STRPRINTF("Script profile written to %s."_fmt, script_profile_txt));
+        return ATCE::OKAY;
+    }
+    else if (message)
+        return ATCE::USAGE;
+
+    for (AString line : script_profile_report(5))
+        clif_displaymessage(s, line);
+
+    return ATCE::OKAY;
+}
+
+static
+ATCE atcommand_autosave(Session *s, dumb_ptr<map_session_data>,
+        ZString message)
+{
+    if (message == "reset"_s)
+        pc_autosave_reset();
+    else if (message)
+        return ATCE::USAGE;
+
+    for (AString line : pc_autosave_report())
+        clif_displaymessage(s, line);
+
+    return ATCE::OKAY;
+}
+
 static
 ATCE atcommand_chardelitem(Session *s, dumb_ptr<map_session_data> sd,
         ZString message)
@@ -5208,6 +5277,15 @@ Map<XString, AtCommandInfo> atcommand_info =
     {"servertime"_s, {""_s,
         0, atcommand_servertime,
         "Print the server's idea of the current time"_s}},
+    {"mobsleep"_s, {""_s,
+        60, atcommand_mobsleep,
+        "Show how often sleeping monsters are woken"_s}},
+    {"scriptprofile"_s, {"[on|off|reset|dump]"_s,
+        60, atcommand_scriptprofile,
+        "Show or control the NPC script profiler"_s}},
+    {"autosave"_s, {"[reset]"_s,
+        60, atcommand_autosave,
+        "Show how far behind character autosaves are"_s}},
     {"chardelitem"_s, {"<item-name-or-id> <count> <charname>"_s,
         60, atcommand_chardelitem,
         "Delete items from a player's inventory"_s}},
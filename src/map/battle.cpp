@@ -2284,6 +2284,10 @@ Battle_Config init_battle_config()
         battle_config.mask_ip_gms = 1;
 
         battle_config.mob_splash_radius = -1;
+        battle_config.mob_lazy_sleep = 0;
+        battle_config.script_profile = 0;
+        battle_config.script_optimize = 0;
+        battle_config.script_slice = 0;
     }
     return battle_config;
 }
@@ -2406,6 +2410,10 @@ bool battle_config_read(ZString cfgName)
             BATTLE_CONFIG_VAR(packet_spam_kick),
             BATTLE_CONFIG_VAR(mask_ip_gms),
             BATTLE_CONFIG_VAR(mob_splash_radius),
+            BATTLE_CONFIG_VAR(mob_lazy_sleep),
+            BATTLE_CONFIG_VAR(script_profile),
+            BATTLE_CONFIG_VAR(script_optimize),
+            BATTLE_CONFIG_VAR(script_slice),
         };
 
         if (is_comment(line))
@@ -216,6 +216,10 @@ extern struct Battle_Config
     int itemheal_regeneration_factor;
 
     int mob_splash_radius;
+    int mob_lazy_sleep;
+    int script_profile;
+    int script_optimize;
+    int script_slice;
 } battle_config;
 
 bool battle_config_read(ZString cfgName);
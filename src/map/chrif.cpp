@@ -36,6 +36,7 @@
 #include "../proto2/char-map.hpp"
 
 #include "../mmo/human_time_diff.hpp"
+#include "../high/char_delta.hpp"
 #include "../high/mmo.hpp"
 
 #include "../wire/packets.hpp"
@@ -65,6 +66,8 @@ static
 AccountPass passwd;
 static
 int chrif_state;
+// a full 0x2b01 save at least this often, even if nothing much changed
+constexpr int CHAR_DELTA_MAX_RUN = 16;
 
 // 設定ファイル読み込み関係
 /*==========================================
@@ -118,7 +121,7 @@ int chrif_isconnect(void)
 }
 
 /*==========================================
- *
+ * Returns 1 if the char-server already had everything
  *------------------------------------------
  */
 int chrif_save(dumb_ptr<map_session_data> sd)
@@ -130,18 +133,52 @@ int chrif_save(dumb_ptr<map_session_data> sd)
 
     pc_makesavestatus(sd);
 
-    Packet_Payload<0x2b01> payload_01;
-    payload_01.account_id = block_to_account(sd->bl_id);
-    payload_01.char_id = sd->char_id_;
-    payload_01.char_key = sd->status_key;
-    payload_01.char_data = sd->status;
-    send_ppacket<0x2b01>(char_session, payload_01);
+    auto image = make_unique<NetCharData>();
+    if (!native_to_network(image.get(), sd->status))
+        abort();
+
+    // Send only the changed blocks, unless that is not worth it or
+    // the last full save is too long ago.
+    bool delta = sd->save_base && sd->save_deltas < CHAR_DELTA_MAX_RUN;
+    std::vector<Packet_Repeat<0x2b17>> blocks;
+    if (delta)
+    {
+        blocks = char_delta_diff(*sd->save_base, *image);
+        delta = blocks.size() * sizeof(NetPacket_Repeat<0x2b17>) < sizeof(NetCharData) / 2;
+    }
+    int rv = 0;
+    if (delta && blocks.empty())
+    {
+        rv = 1;
+    }
+    else if (delta)
+    {
+        Packet_Head<0x2b17> head_17;
+        head_17.account_id = block_to_account(sd->bl_id);
+        head_17.char_id = sd->char_id_;
+        head_17.char_key = sd->status_key;
+        head_17.base_checksum = char_delta_checksum(*sd->save_base);
+        send_vpacket<0x2b17, 53, 10>(char_session, head_17, blocks);
+        sd->save_deltas++;
+    }
+    else
+    {
+        Packet_Payload<0x2b01> payload_01;
+        payload_01.account_id = block_to_account(sd->bl_id);
+        payload_01.char_id = sd->char_id_;
+        payload_01.char_key = sd->status_key;
+        payload_01.char_data = sd->status;
+        send_ppacket<0x2b01>(char_session, payload_01);
+        sd->save_deltas = 0;
+    }
+    sd->save_base = std::move(image);
+    sd->last_save = gettick();
 
     //For data sync
     if (sd->state.storage_open)
         storage_storage_save(sd->status_key.account_id, 0);
 
-    return 0;
+    return rv;
 }
 
 /*==========================================
@@ -762,6 +799,23 @@ int chrif_divorce(CharId char_id, CharId partner_id)
     return 0;
 }
 
+/*==========================================
+ * The char-server could not apply a delta save
+ *------------------------------------------
+ */
+static
+void chrif_saveresync(CharId char_id)
+{
+    dumb_ptr<map_session_data> sd = map_nick2sd(map_charid2nick(char_id));
+    if (!sd)
+        return;
+
+    if (battle_config.etc_log)
+        PRINTF("chrif_saveresync: full save of %s\n"_fmt, sd->status_key.name);
+    sd->save_base.reset();
+    chrif_save(sd);
+}
+
 /*==========================================
  * Tell character server someone is divorced
  * Needed to divorce when partner is not connected to map server
@@ -1236,6 +1290,16 @@ void chrif_parse(Session *s)
                 chrif_recvgmaccounts(s, repeat);
                 break;
             }
+            case 0x2b18:
+            {
+                Packet_Fixed<0x2b18> fixed;
+                rv = recv_fpacket<0x2b18, 6>(s, fixed);
+                if (rv != RecvResult::Complete)
+                    break;
+
+                chrif_saveresync(fixed.char_id);
+                break;
+            }
             default:
             {
                 RecvResult r = intif_parse(s, packet_id);
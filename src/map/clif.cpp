@@ -31,6 +31,8 @@
 
 #include "../ints/cmp.hpp"
 
+#include "../range/slice.hpp"
+
 #include "../strings/astring.hpp"
 #include "../strings/zstring.hpp"
 #include "../strings/xstring.hpp"
@@ -570,6 +572,30 @@ int clif_dropflooritem(dumb_ptr<flooritem_data> fitem)
     return 0;
 }
 
+/*==========================================
+ * Announce several floor items dropped around one spot,
+ * with a single area scan and one write per client.
+ *------------------------------------------
+ */
+void clif_dropflooritems(Slice<dumb_ptr<flooritem_data>> fitems)
+{
+    if (!fitems)
+        return;
+
+    Buffer buf;
+    for (dumb_ptr<flooritem_data> fitem : fitems)
+    {
+        if (!fitem->item_data.nameid)
+            continue;
+        Buffer one;
+        clif_set009e(fitem, one);
+        buf.bytes.insert(buf.bytes.end(), one.bytes.begin(), one.bytes.end());
+    }
+    if (buf.bytes.empty())
+        return;
+    clif_send(buf, fitems.front(), SendWho::AREA);
+}
+
 /*==========================================
  *
  *------------------------------------------
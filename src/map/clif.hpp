@@ -50,6 +50,7 @@ int clif_authok(dumb_ptr<map_session_data>);
 int clif_authfail_fd(Session *, int);
 int clif_charselectok(BlockId);
 int clif_dropflooritem(dumb_ptr<flooritem_data>);
+void clif_dropflooritems(Slice<dumb_ptr<flooritem_data>>);
 int clif_clearflooritem(dumb_ptr<flooritem_data>, Session *);
 int clif_clearchar(dumb_ptr<block_list>, BeingRemoveWhy); // area or fd
 int clif_clearchar_delay(tick_t, dumb_ptr<block_list>, BeingRemoveWhy);
@@ -45,6 +45,7 @@ struct block_list;
 struct map_session_data;
 struct npc_data;
 struct mob_data;
+struct mob_spawn_group;
 struct flooritem_data;
 //struct magic::invocation;
 struct map_local;
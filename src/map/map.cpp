@@ -30,6 +30,8 @@
 #include <cassert>
 #include <cstdlib>
 
+#include <algorithm>
+
 #include "../compat/nullpo.hpp"
 #include "../compat/fun.hpp"
 
@@ -74,6 +76,8 @@
 #include "npc-parse.hpp"
 #include "party.hpp"
 #include "pc.hpp"
+#include "script-call.hpp"
+#include "script-profile.hpp"
 #include "script-startup.hpp"
 #include "skill.hpp"
 #include "storage.hpp"
@@ -108,6 +112,7 @@ static
 BlockId first_free_object_id = BlockId();
 
 interval_t autosave_time = DEFAULT_AUTOSAVE_INTERVAL;
+int autosave_batch = 1;
 int save_settings = 0xFFFF;
 
 AString motd_txt = "conf/motd.txt"_s;
@@ -224,7 +229,10 @@ int map_addblock(dumb_ptr<block_list> bl)
             bl->bl_next->bl_prev = bl;
         m->blocks.ref(x / BLOCK_SIZE, y / BLOCK_SIZE).normal = bl;
         if (bl->bl_type == BL::PC)
+        {
             m->users++;
+            m->blocks.ref(x / BLOCK_SIZE, y / BLOCK_SIZE).pc_count++;
+        }
     }
 
     return 0;
@@ -252,7 +260,10 @@ int map_delblock(dumb_ptr<block_list> bl)
     }
 
     if (bl->bl_type == BL::PC)
+    {
         bl->bl_m->users--;
+        bl->bl_m->blocks.ref(bl->bl_x / BLOCK_SIZE, bl->bl_y / BLOCK_SIZE).pc_count--;
+    }
 
     if (bl->bl_next)
         bl->bl_next->bl_prev = bl->bl_prev;
@@ -278,6 +289,30 @@ int map_delblock(dumb_ptr<block_list> bl)
     return 0;
 }
 
+/*==========================================
+ * Count the PCs in every block touching the area.
+ * This is a cheap upper bound on the PCs inside it;
+ * zero means there is certainly nobody there.
+ *------------------------------------------
+ */
+int map_count_pc_blocks(Borrowed<map_local> m, int x0, int y0, int x1, int y1)
+{
+    if (x0 < 0)
+        x0 = 0;
+    if (y0 < 0)
+        y0 = 0;
+    if (x1 >= m->xs)
+        x1 = m->xs - 1;
+    if (y1 >= m->ys)
+        y1 = m->ys - 1;
+
+    int count = 0;
+    for (int by = y0 / BLOCK_SIZE; by <= y1 / BLOCK_SIZE; by++)
+        for (int bx = x0 / BLOCK_SIZE; bx <= x1 / BLOCK_SIZE; bx++)
+            count += m->blocks.ref(bx, by).pc_count;
+    return count;
+}
+
 /*==========================================
  * セル上のPCとMOBの数を数える (グランドクロス用)
  *------------------------------------------
@@ -703,17 +738,18 @@ std::pair<uint16_t, uint16_t> map_searchrandfreecell(Borrowed<map_local> m, int
  * item_dataはamount以外をcopyする
  *------------------------------------------
  */
-BlockId map_addflooritem_any(Item *item_data, int amount,
+static
+dumb_ptr<flooritem_data> map_addflooritem_sub(Item *item_data, int amount,
         Borrowed<map_local> m, int x, int y,
         dumb_ptr<map_session_data> *owners, interval_t *owner_protection,
         interval_t lifetime, int dispersal)
 {
     dumb_ptr<flooritem_data> fitem = nullptr;
 
-    nullpo_retr(BlockId(), item_data);
+    nullpo_retr(nullptr, item_data);
     auto xy = map_searchrandfreecell(m, x, y, dispersal);
     if (xy.first == 0 && xy.second == 0)
-        return BlockId();
+        return nullptr;
 
     fitem.new_();
     fitem->bl_type = BL::ITEM;
@@ -732,7 +768,7 @@ BlockId map_addflooritem_any(Item *item_data, int amount,
     if (!fitem->bl_id)
     {
         fitem.delete_();
-        return BlockId();
+        return nullptr;
     }
 
     tick_t tick = gettick();
@@ -763,12 +799,33 @@ BlockId map_addflooritem_any(Item *item_data, int amount,
                 fitem->bl_id));
 
     map_addblock(fitem);
+
+    return fitem;
+}
+
+BlockId map_addflooritem_any(Item *item_data, int amount,
+        Borrowed<map_local> m, int x, int y,
+        dumb_ptr<map_session_data> *owners, interval_t *owner_protection,
+        interval_t lifetime, int dispersal)
+{
+    dumb_ptr<flooritem_data> fitem = map_addflooritem_sub(item_data, amount,
+            m, x, y,
+            owners, owner_protection,
+            lifetime, dispersal);
+    if (!fitem)
+        return BlockId();
+
     clif_dropflooritem(fitem);
 
     return fitem->bl_id;
 }
 
-BlockId map_addflooritem(Item *item_data, int amount,
+/*==========================================
+ * Like map_addflooritem, but nothing is sent to the clients yet;
+ * the caller collects the items for clif_dropflooritems.
+ *------------------------------------------
+ */
+dumb_ptr<flooritem_data> map_addflooritem_quiet(Item *item_data, int amount,
         Borrowed<map_local> m, int x, int y,
         dumb_ptr<map_session_data> first_sd,
         dumb_ptr<map_session_data> second_sd,
@@ -783,11 +840,28 @@ BlockId map_addflooritem(Item *item_data, int amount,
         owner_protection[2] = owner_protection[1] + static_cast<interval_t>(battle_config.item_third_get_time);
     }
 
-    return map_addflooritem_any(item_data, amount, m, x, y,
+    return map_addflooritem_sub(item_data, amount, m, x, y,
             owners, owner_protection,
             static_cast<interval_t>(battle_config.flooritem_lifetime), 1);
 }
 
+BlockId map_addflooritem(Item *item_data, int amount,
+        Borrowed<map_local> m, int x, int y,
+        dumb_ptr<map_session_data> first_sd,
+        dumb_ptr<map_session_data> second_sd,
+        dumb_ptr<map_session_data> third_sd)
+{
+    dumb_ptr<flooritem_data> fitem = map_addflooritem_quiet(item_data, amount,
+            m, x, y,
+            first_sd, second_sd, third_sd);
+    if (!fitem)
+        return BlockId();
+
+    clif_dropflooritem(fitem);
+
+    return fitem->bl_id;
+}
+
 /*==========================================
  * charid_dbへ追加(返信待ちがあれば返信)
  *------------------------------------------
@@ -870,6 +944,8 @@ void map_quit(dumb_ptr<map_session_data> sd)
     pc_makesavestatus(sd);
     //クローンスキルで覚えたスキルは消す
 
+    // the last save goes out whole, whatever the delta count
+    sd->save_base.reset();
     //The storage closing routines will save the char if needed. [Skotlex]
     if (!sd->state.storage_open)
         chrif_save(sd);
@@ -877,6 +953,7 @@ void map_quit(dumb_ptr<map_session_data> sd)
         storage_storage_quit(sd);
 
     sd->npc_stackbuf.clear();
+    script_slice_drop(sd->bl_id);
 
     map_delblock(sd);
 
@@ -1593,6 +1670,10 @@ bool map_config_read(ZString cfgName)
             if (autosave_time <= interval_t::zero())
                 autosave_time = DEFAULT_AUTOSAVE_INTERVAL;
         }
+        else if (w1 == "autosave_batch"_s)
+        {
+            autosave_batch = std::max(1, atoi(w2.c_str()));
+        }
         else if (w1 == "motd_txt"_s)
         {
             motd_txt = w2;
@@ -1601,6 +1682,10 @@ bool map_config_read(ZString cfgName)
         {
             mapreg_txt = w2;
         }
+        else if (w1 == "script_profile_txt"_s)
+        {
+            script_profile_txt = w2;
+        }
         else if (w1 == "gm_log"_s)
         {
             gm_log = std::move(w2);
@@ -1669,6 +1754,7 @@ void term_func(void)
 
     maps_db.clear();
 
+    do_final_script_profile();
     do_final_script();
     do_final_itemdb();
     do_final_storage();
@@ -1770,6 +1856,7 @@ int do_init(Slice<ZString> argv)
     do_init_clif();
     do_init_mob2();
     do_init_script();
+    do_init_script_profile();
 
     runflag &= do_init_npc();
     do_init_pc();
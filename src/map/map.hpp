@@ -27,6 +27,9 @@
 #include <chrono>
 #include <functional>
 #include <list>
+#include <map>
+#include <memory>
+#include <vector>
 
 #include "../ints/udl.hpp"
 
@@ -41,6 +44,8 @@
 #include "../net/socket.hpp"
 #include "../net/timer.t.hpp"
 
+#include "../proto2/net-CharData.hpp"
+
 #include "battle.t.hpp"
 #include "../mmo/clif.t.hpp"
 #include "mapflag.hpp"
@@ -156,6 +161,11 @@ struct map_session_data : block_list, SessionData
     unsigned char tmw_version;  // tmw client version
     CharKey status_key;
     CharData status;
+    // what the char-server last got from chrif_save(), for delta saves
+    std::unique_ptr<NetCharData> save_base;
+    int save_deltas = 0;
+    // when the char-server last had all of status
+    tick_t last_save;
     GenericArray<Option<Borrowed<struct item_data>>, InventoryIndexing<IOff0, MAX_INVENTORY>> inventory_data =
     {{
         None, None, None, None, None, None, None, None, None, None,
@@ -259,6 +269,8 @@ struct map_session_data : block_list, SessionData
     // can't be DMap because we want predictable .c_str()s
     // TODO this can change now
     Map<SIR, RString> regstrm;
+    // interned variable name -> index into status.global_reg + 1, 0 if unset
+    std::vector<uint8_t> global_reg_slot;
 
     earray<struct status_change, StatusChange, StatusChange::MAX_STATUSCHANGE> sc_data;
 
@@ -403,6 +415,22 @@ public:
     RString message;
 };
 
+/// Walkable cells of one spawn rectangle, computed once at load and
+/// shared by every mob of the spawn definitions using that rectangle.
+struct mob_spawn_group
+{
+    short x0, y0, xs, ys;
+    std::vector<std::pair<short, short>> cells;
+};
+
+/// A mob drop (or looted item) waiting in map_local::drop_queue.
+struct delay_item_drop
+{
+    short x, y;
+    Item item_data;
+    BlockId first_id, second_id, third_id;
+};
+
 constexpr int MOB_XP_BONUS_BASE = 1024;
 constexpr int MOB_XP_BONUS_SHIFT = 10;
 
@@ -417,6 +445,8 @@ struct mob_data : block_list
         Borrowed<map_local> m = borrow(undefined_gat);
         short x0, y0, xs, ys;
         interval_t delay1, delay2;
+        // None for script-spawned mobs, which pick cells the slow way
+        Option<P<mob_spawn_group>> group = None;
     } spawn;
     MobName name;
     struct
@@ -431,6 +461,7 @@ struct mob_data : block_list
         unsigned change_walk_target:1;
         unsigned walk_easy:1;
         unsigned special_mob_ai:3;
+        unsigned asleep:1;
     } state;
     Timer timer;
     short to_x, to_y;
@@ -441,6 +472,8 @@ struct mob_data : block_list
     tick_t next_walktime;
     tick_t attackabletime;
     tick_t last_deadtime, last_spawntime, last_thinktime;
+    // when the lazy AI froze this mob (see mob_lazy_sleep)
+    tick_t sleep_tick;
     tick_t canmove_tick;
     short move_fail_count;
     struct DmgLogEntry
@@ -480,6 +513,8 @@ struct mob_data : block_list
 struct BlockLists
 {
     dumb_ptr<block_list> normal, mobs_only;
+    // players linked into normal, kept by map_addblock/map_delblock
+    int pc_count;
 };
 
 struct map_abstract
@@ -505,6 +540,11 @@ struct map_local : map_abstract
     Point save;
     Point resave;
     Array<dumb_ptr<npc_data>, MAX_NPC_PER_MAP> npc;
+    std::vector<std::unique_ptr<mob_spawn_group>> spawn_groups;
+    // dead mobs waiting to respawn, drained by mob_respawn_timer
+    std::multimap<tick_t, BlockId> respawn_queue;
+    // delayed mob drops, drained by mob_drop_timer
+    std::multimap<tick_t, delay_item_drop> drop_queue;
 };
 
 struct map_remote : map_abstract
@@ -531,6 +571,7 @@ struct flooritem_data : block_list
 };
 
 extern interval_t autosave_time;
+extern int autosave_batch;
 extern int save_settings;
 
 extern AString motd_txt;
@@ -571,6 +612,7 @@ void map_foreachinmovearea(std::function<void(dumb_ptr<block_list>)>,
         BL);
 //block関連に追加
 int map_count_oncell(Borrowed<map_local> m, int x, int y);
+int map_count_pc_blocks(Borrowed<map_local> m, int x0, int y0, int x1, int y1);
 // 一時的object関連
 BlockId map_addobject(dumb_ptr<block_list>);
 void map_delobject(BlockId, BL type);
@@ -605,6 +647,10 @@ BlockId map_addflooritem(Item *, int,
         Borrowed<map_local>, int, int,
         dumb_ptr<map_session_data>, dumb_ptr<map_session_data>,
         dumb_ptr<map_session_data>);
+dumb_ptr<flooritem_data> map_addflooritem_quiet(Item *, int,
+        Borrowed<map_local>, int, int,
+        dumb_ptr<map_session_data>, dumb_ptr<map_session_data>,
+        dumb_ptr<map_session_data>);
 
 // キャラid＝＞キャラ名 変換関連
 extern
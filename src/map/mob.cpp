@@ -67,6 +67,8 @@ constexpr interval_t MIN_MOBTHINKTIME = 100_ms;
 constexpr random_::Fraction MOB_LAZYMOVEPERC {50, 1000};
 // Warp probability in the negligent mode MOB (rate of 1000 minute)
 constexpr random_::Fraction MOB_LAZYWARPPERC {20, 1000};
+// Mean gap between lazy AI walk decisions (see mob_ai_sub_lazy).
+constexpr interval_t MOB_LAZYWALKINTERVAL = 10_s;
 
 static
 struct mob_db_ mob_db[2001];
@@ -75,6 +77,8 @@ struct mob_db_& get_mob_db(Species s)
     return mob_db[unwrap<Species>(s)];
 }
 
+struct Mob_Sleep_Stats mob_sleep_stats;
+
 /*==========================================
  * Local prototype declaration   (only required thing)
  *------------------------------------------
@@ -1020,13 +1024,85 @@ int mob_walktoxy(dumb_ptr<mob_data> md, int x, int y, int easy)
 }
 
 /*==========================================
- * mob spawn with delay (timer function)
+ * Find (or build) the shared cell list of a spawn rectangle
+ *------------------------------------------
+ */
+P<mob_spawn_group> mob_spawn_group_get(P<map_local> m,
+        short x0, short y0, short xs, short ys)
+{
+    for (auto& group : m->spawn_groups)
+    {
+        if (group->x0 == x0 && group->y0 == y0
+            && group->xs == xs && group->ys == ys)
+            return borrow(*group);
+    }
+
+    std::unique_ptr<mob_spawn_group> group = make_unique<mob_spawn_group>();
+    group->x0 = x0;
+    group->y0 = y0;
+    group->xs = xs;
+    group->ys = ys;
+
+    int x_lo, x_hi, y_lo, y_hi;
+    if (x0 == 0 && y0 == 0)
+    {
+        x_lo = 1;
+        x_hi = m->xs - 2;
+        y_lo = 1;
+        y_hi = m->ys - 2;
+    }
+    else
+    {
+        x_lo = x0 - xs / 2;
+        x_hi = x_lo + xs;
+        y_lo = y0 - ys / 2;
+        y_hi = y_lo + ys;
+    }
+    for (int y = y_lo; y <= y_hi; y++)
+        for (int x = x_lo; x <= x_hi; x++)
+            if (!bool(map_getcell(m, x, y) & MapCell::UNWALKABLE))
+                group->cells.push_back({static_cast<short>(x), static_cast<short>(y)});
+
+    m->spawn_groups.push_back(std::move(group));
+    return borrow(*m->spawn_groups.back());
+}
+
+/*==========================================
+ * Put a dead mob on its map's respawn queue
  *------------------------------------------
  */
 static
-void mob_delayspawn(TimerData *, tick_t, BlockId m)
+void mob_queue_respawn(dumb_ptr<mob_data> md, tick_t due)
 {
-    mob_spawn(m);
+    md->spawn.m->respawn_queue.insert({due, md->bl_id});
+}
+
+/*==========================================
+ * Respawn every due mob on every map (interval timer function)
+ *------------------------------------------
+ */
+static
+void mob_respawn_timer(TimerData *, tick_t tick)
+{
+    std::vector<BlockId> due;
+    for (auto& mit : maps_db)
+    {
+        if (!mit.second->gat)
+            continue;
+        P<map_local> m = borrow(*mit.second).downcast_to<map_local>();
+        if (m->respawn_queue.empty())
+            continue;
+
+        // mob_spawn may requeue, so detach the batch first
+        auto end = m->respawn_queue.upper_bound(tick);
+        for (auto it = m->respawn_queue.begin(); it != end; ++it)
+            due.push_back(it->second);
+        m->respawn_queue.erase(m->respawn_queue.begin(), end);
+
+        for (BlockId id : due)
+            mob_spawn(id);
+        due.clear();
+    }
 }
 
 /*==========================================
@@ -1067,13 +1143,48 @@ int mob_setdelayspawn(BlockId id)
     tick_t spawntime3 = gettick() + 5_s;
     tick_t spawntime = std::max({spawntime1, spawntime2, spawntime3});
 
-    Timer(spawntime,
-            std::bind(mob_delayspawn, ph::_1, ph::_2,
-                id)
-    ).detach();
+    mob_queue_respawn(md, spawntime);
     return 0;
 }
 
+/*==========================================
+ * Choose where a mob (re)appears
+ *------------------------------------------
+ */
+static
+bool mob_spawn_pickcell(dumb_ptr<mob_data> md, int *x, int *y)
+{
+    if OPTION_IS_SOME(group, md->spawn.group)
+    {
+        if (group->cells.empty())
+            return false;
+        const auto& cell = random_::choice(group->cells);
+        *x = cell.first;
+        *y = cell.second;
+        return true;
+    }
+
+    int i = 0;
+    do
+    {
+        if (md->spawn.x0 == 0 && md->spawn.y0 == 0)
+        {
+            *x = random_::in(1, md->bl_m->xs - 2);
+            *y = random_::in(1, md->bl_m->ys - 2);
+        }
+        else
+        {
+            *x = md->spawn.x0 - md->spawn.xs / 2 + random_::in(0, md->spawn.xs);
+            *y = md->spawn.y0 - md->spawn.ys / 2 + random_::in(0, md->spawn.ys);
+        }
+        i++;
+    }
+    while (bool(map_getcell(md->bl_m, *x, *y) & MapCell::UNWALKABLE)
+        && i < 50);
+
+    return i < 50;
+}
+
 /*==========================================
  * Mob spawning. Initialization is also variously here.
  *------------------------------------------
@@ -1104,35 +1215,10 @@ int mob_spawn(BlockId id)
     }
 
     md->bl_m = md->spawn.m;
+    if (!mob_spawn_pickcell(md, &x, &y))
     {
-        int i = 0;
-        do
-        {
-            if (md->spawn.x0 == 0 && md->spawn.y0 == 0)
-            {
-                x = random_::in(1, md->bl_m->xs - 2);
-                y = random_::in(1, md->bl_m->ys - 2);
-            }
-            else
-            {
-                // TODO: move this logic earlier - possibly all the way
-                // into the data files
-                x = md->spawn.x0 - md->spawn.xs / 2 + random_::in(0, md->spawn.xs);
-                y = md->spawn.y0 - md->spawn.ys / 2 + random_::in(0, md->spawn.ys);
-            }
-            i++;
-        }
-        while (bool(map_getcell(md->bl_m, x, y) & MapCell::UNWALKABLE)
-            && i < 50);
-
-        if (i >= 50)
-        {
-            Timer(tick + 5_s,
-                    std::bind(mob_delayspawn, ph::_1, ph::_2,
-                        id)
-            ).detach();
-            return 1;
-        }
+        mob_queue_respawn(md, tick + 5_s);
+        return 1;
     }
 
     md->to_x = md->bl_x = x;
@@ -1750,6 +1836,60 @@ int mob_randomwalk(dumb_ptr<mob_data> md, tick_t tick)
     return 0;
 }
 
+/*==========================================
+ * Bring a mob frozen by mob_lazy_sleep up to date in one step
+ *------------------------------------------
+ */
+static
+void mob_wake(dumb_ptr<mob_data> md, tick_t tick)
+{
+    md->state.asleep = 0;
+    mob_sleep_stats.wakeups++;
+    if (md->bl_prev == nullptr)
+        return;
+
+    // Mobs have no natural regeneration, so only the lazy AI's
+    // movement needs replaying: a walk decision every
+    // MOB_LAZYWALKINTERVAL or so, which walks with MOB_LAZYMOVEPERC
+    // and otherwise may rebirth a non-boss slave with MOB_LAZYWARPPERC.
+    if (!bool(get_mob_db(md->mob_class).mode & MobMode::CAN_MOVE)
+        || !mob_can_move(md))
+        return;
+    double turns = std::chrono::duration<double>(tick - md->sleep_tick) / MOB_LAZYWALKINTERVAL;
+    if (turns < 1)
+        return;
+    auto any_of = [turns](double p)
+    {
+        return random_::Fraction{static_cast<int>((1 - std::pow(1 - p, turns)) * 1000), 1000};
+    };
+    double p_move = static_cast<double>(MOB_LAZYMOVEPERC.num) / MOB_LAZYMOVEPERC.den;
+    double p_warp = (1 - p_move) * MOB_LAZYWARPPERC.num / MOB_LAZYWARPPERC.den;
+
+    if (md->spawn.x0 <= 0
+        && md->master_id
+        && !bool(get_mob_db(md->mob_class).mode & MobMode::BOSS))
+    {
+        if (random_::chance(any_of(p_warp)))
+        {
+            mob_sleep_stats.catchup_moves++;
+            mob_spawn(md->bl_id);
+        }
+        return;
+    }
+
+    // After a few walks its position is anywhere in its spawn area.
+    if OPTION_IS_SOME(group, md->spawn.group)
+    {
+        if (group->cells.empty() || !random_::chance(any_of(p_move)))
+            return;
+        const auto& cell = random_::choice(group->cells);
+        mob_sleep_stats.catchup_moves++;
+        clif_clearchar(md, BeingRemoveWhy::GONE);
+        mob_warp(md, None, cell.first, cell.second, BeingRemoveWhy::NEGATIVE1);
+        clif_spawnmob(md);
+    }
+}
+
 /*==========================================
  * AI of MOB whose is near a Player
  *------------------------------------------
@@ -1772,6 +1912,9 @@ void mob_ai_sub_hard(dumb_ptr<block_list> bl, tick_t tick)
         return;
     md->last_thinktime = tick;
 
+    if (md->state.asleep)
+        mob_wake(md, tick);
+
     if (md->skilltimer || md->bl_prev == nullptr)
     {
         // Under a skill aria and death
@@ -1859,12 +2002,15 @@ void mob_ai_sub_hard(dumb_ptr<block_list> bl, tick_t tick)
                     md->bl_x + AREA_SIZE * 2, md->bl_y + AREA_SIZE * 2,
                     BL::NUL);
         }
-        else
+        else if (map_count_pc_blocks(md->bl_m,
+                    md->bl_x - 8, md->bl_y - 8,
+                    md->bl_x + 8, md->bl_y + 8))
         {
+            // only PCs closer than 9 cells can be locked onto
             map_foreachinarea(std::bind(mob_ai_sub_hard_activesearch, ph::_1, md, &i),
                     md->bl_m,
-                    md->bl_x - AREA_SIZE * 2, md->bl_y - AREA_SIZE * 2,
-                    md->bl_x + AREA_SIZE * 2, md->bl_y + AREA_SIZE * 2,
+                    md->bl_x - 8, md->bl_y - 8,
+                    md->bl_x + 8, md->bl_y + 8,
                     BL::PC);
         }
     }
@@ -2120,6 +2266,26 @@ void mob_ai_sub_lazy(dumb_ptr<block_list> bl, tick_t tick)
         return;
     }
 
+    if (battle_config.mob_lazy_sleep && md->bl_m->users > 0)
+    {
+        // Nobody is near enough to notice, so freeze until
+        // mob_ai_sub_hard sees a PC and mob_wake catches up.
+        if (!md->state.asleep)
+        {
+            md->state.asleep = 1;
+            md->sleep_tick = tick;
+            mob_sleep_stats.sleeps++;
+            return;
+        }
+        mob_sleep_stats.lazy_skips++;
+        if (md->next_walktime < tick)
+        {
+            mob_sleep_stats.walk_decisions_skipped++;
+            md->next_walktime = tick + 5_s + std::chrono::milliseconds(random_::to(10 * 1000));
+        }
+        return;
+    }
+
     if (md->next_walktime < tick
         && bool(get_mob_db(md->mob_class).mode & MobMode::CAN_MOVE)
         && mob_can_move(md))
@@ -2169,89 +2335,105 @@ void mob_ai_lazy(TimerData *, tick_t tick)
 }
 
 /*==========================================
- * The structure object for item drop with delay
- * Since it is only two being able to pass [ int ] a timer function
- * Data is put in and passed to this structure object.
+ * Queue an item to drop where a mob died
  *------------------------------------------
  */
-struct delay_item_drop
-{
-    Borrowed<map_local> m = borrow(undefined_gat);
-    int x, y;
-    ItemNameId nameid;
-    int amount;
-    dumb_ptr<map_session_data> first_sd, second_sd, third_sd;
-};
-
-struct delay_item_drop2
-{
-    Borrowed<map_local> m = borrow(undefined_gat);
-    int x, y;
-    Item item_data;
-    dumb_ptr<map_session_data> first_sd, second_sd, third_sd;
-};
+static
+void mob_queue_item_drop(dumb_ptr<mob_data> md, tick_t due, Item item,
+        dumb_ptr<map_session_data> first_sd,
+        dumb_ptr<map_session_data> second_sd,
+        dumb_ptr<map_session_data> third_sd)
+{
+    struct delay_item_drop ditem {};
+    ditem.x = md->bl_x;
+    ditem.y = md->bl_y;
+    ditem.item_data = item;
+    if (first_sd)
+        ditem.first_id = first_sd->bl_id;
+    if (second_sd)
+        ditem.second_id = second_sd->bl_id;
+    if (third_sd)
+        ditem.third_id = third_sd->bl_id;
+    md->bl_m->drop_queue.insert({due, ditem});
+}
 
 /*==========================================
- * item drop with delay (timer function)
+ * Materialise one queued drop, or nullptr if it was auto-picked up
  *------------------------------------------
  */
 static
-void mob_delay_item_drop(TimerData *, tick_t, struct delay_item_drop ditem)
+dumb_ptr<flooritem_data> mob_delay_item_drop(Borrowed<map_local> m,
+        struct delay_item_drop& ditem)
 {
-    Item temp_item {};
     PickupFail flag;
-
-    temp_item.nameid = ditem.nameid;
-    temp_item.amount = ditem.amount;
+    dumb_ptr<map_session_data> first_sd = map_id_is_player(ditem.first_id);
+    dumb_ptr<map_session_data> second_sd = map_id_is_player(ditem.second_id);
+    dumb_ptr<map_session_data> third_sd = map_id_is_player(ditem.third_id);
 
     if (battle_config.item_auto_get == 1)
     {
-        if (ditem.first_sd
+        if (first_sd
             && (flag =
-                pc_additem(ditem.first_sd, &temp_item, ditem.amount))
+                pc_additem(first_sd, &ditem.item_data,
+                            ditem.item_data.amount))
             != PickupFail::OKAY)
         {
-            clif_additem(ditem.first_sd, IOff0::from(0), 0, flag);
-            map_addflooritem(&temp_item, 1,
-                    ditem.m, ditem.x, ditem.y,
-                    ditem.first_sd, ditem.second_sd, ditem.third_sd);
+            clif_additem(first_sd, IOff0::from(0), 0, flag);
+            return map_addflooritem_quiet(&ditem.item_data, ditem.item_data.amount,
+                    m, ditem.x, ditem.y,
+                    first_sd, second_sd, third_sd);
         }
-        return;
+        return nullptr;
     }
 
-    map_addflooritem(&temp_item, 1,
-            ditem.m, ditem.x, ditem.y,
-            ditem.first_sd, ditem.second_sd, ditem.third_sd);
+    return map_addflooritem_quiet(&ditem.item_data, ditem.item_data.amount,
+            m, ditem.x, ditem.y,
+            first_sd, second_sd, third_sd);
 }
 
 /*==========================================
- * item drop (timer function)-lootitem with delay
+ * Drop every due item on every map (interval timer function)
+ * Drops from the same spot are announced together.
  *------------------------------------------
  */
 static
-void mob_delay_item_drop2(TimerData *, tick_t, struct delay_item_drop2 ditem)
+void mob_drop_timer(TimerData *, tick_t tick)
 {
-    PickupFail flag;
-
-    if (battle_config.item_auto_get == 1)
+    std::vector<struct delay_item_drop> due;
+    std::vector<dumb_ptr<flooritem_data>> dropped;
+    for (auto& mit : maps_db)
     {
-        if (ditem.first_sd
-            && (flag =
-                pc_additem(ditem.first_sd, &ditem.item_data,
-                            ditem.item_data.amount))
-            != PickupFail::OKAY)
+        if (!mit.second->gat)
+            continue;
+        P<map_local> m = borrow(*mit.second).downcast_to<map_local>();
+        if (m->drop_queue.empty())
+            continue;
+
+        auto end = m->drop_queue.upper_bound(tick);
+        for (auto it = m->drop_queue.begin(); it != end; ++it)
+            due.push_back(it->second);
+        m->drop_queue.erase(m->drop_queue.begin(), end);
+
+        // batch consecutive drops from one spot (i.e. one corpse)
+        std::stable_sort(due.begin(), due.end(),
+                [](const struct delay_item_drop& l, const struct delay_item_drop& r)
+                {
+                    return std::make_pair(l.x, l.y) < std::make_pair(r.x, r.y);
+                });
+        for (size_t i = 0; i < due.size(); i++)
         {
-            clif_additem(ditem.first_sd, IOff0::from(0), 0, flag);
-            map_addflooritem(&ditem.item_data, ditem.item_data.amount,
-                    ditem.m, ditem.x, ditem.y,
-                    ditem.first_sd, ditem.second_sd, ditem.third_sd);
+            dumb_ptr<flooritem_data> fitem = mob_delay_item_drop(m, due[i]);
+            if (fitem)
+                dropped.push_back(fitem);
+            if (i + 1 == due.size()
+                || due[i + 1].x != due[i].x || due[i + 1].y != due[i].y)
+            {
+                clif_dropflooritems(dropped);
+                dropped.clear();
+            }
         }
-        return;
+        due.clear();
     }
-
-    map_addflooritem(&ditem.item_data, ditem.item_data.amount,
-            ditem.m, ditem.x, ditem.y,
-            ditem.first_sd, ditem.second_sd, ditem.third_sd);
 }
 
 /*==========================================
@@ -2635,37 +2817,21 @@ int mob_damage(dumb_ptr<block_list> src, dumb_ptr<mob_data> md, int damage,
                 if (!random_::chance(drop_rate))
                     continue;
 
-                struct delay_item_drop ditem {};
-                ditem.nameid = get_mob_db(md->mob_class).dropitem[i].nameid;
-                ditem.amount = 1;
-                ditem.m = md->bl_m;
-                ditem.x = md->bl_x;
-                ditem.y = md->bl_y;
-                ditem.first_sd = mvp_sd;
-                ditem.second_sd = second_sd;
-                ditem.third_sd = third_sd;
-                Timer(tick + 500_ms + static_cast<interval_t>(i),
-                        std::bind(mob_delay_item_drop, ph::_1, ph::_2,
-                            ditem)
-                ).detach();
+                Item temp_item {};
+                temp_item.nameid = get_mob_db(md->mob_class).dropitem[i].nameid;
+                temp_item.amount = 1;
+                mob_queue_item_drop(md, tick + 500_ms + static_cast<interval_t>(i),
+                        temp_item,
+                        mvp_sd, second_sd, third_sd);
             }
             {
                 int i = 0;
                 for (Item lit : md->lootitemv)
                 {
-                    struct delay_item_drop2 ditem {};
-                    ditem.item_data = lit;
-                    ditem.m = md->bl_m;
-                    ditem.x = md->bl_x;
-                    ditem.y = md->bl_y;
-                    ditem.first_sd = mvp_sd;
-                    ditem.second_sd = second_sd;
-                    ditem.third_sd = third_sd;
                     // ?
-                    Timer(tick + 540_ms + static_cast<interval_t>(i),
-                            std::bind(mob_delay_item_drop2, ph::_1, ph::_2,
-                                ditem)
-                    ).detach();
+                    mob_queue_item_drop(md, tick + 540_ms + static_cast<interval_t>(i),
+                            lit,
+                            mvp_sd, second_sd, third_sd);
                     i++;
                 }
             }
@@ -3733,6 +3899,7 @@ bool mob_readskilldb(ZString filename)
 
 void do_init_mob2(void)
 {
+    mob_sleep_stats.since = gettick();
     Timer(gettick() + MIN_MOBTHINKTIME,
             mob_ai_hard,
             MIN_MOBTHINKTIME
@@ -3741,5 +3908,13 @@ void do_init_mob2(void)
             mob_ai_lazy,
             MIN_MOBTHINKTIME * 10
     ).detach();
+    Timer(gettick() + MIN_MOBTHINKTIME,
+            mob_respawn_timer,
+            MIN_MOBTHINKTIME
+    ).detach();
+    Timer(gettick() + MIN_MOBTHINKTIME,
+            mob_drop_timer,
+            MIN_MOBTHINKTIME
+    ).detach();
 }
 } // namespace tmwa
@@ -86,6 +86,19 @@ struct mob_db_
 };
 struct mob_db_& get_mob_db(Species);
 
+/// Counters for battle_config.mob_lazy_sleep, shown by @mobsleep.
+extern struct Mob_Sleep_Stats
+{
+    tick_t since;
+    long sleeps, wakeups;
+    // lazy AI passes that returned at once because the mob was asleep
+    long lazy_skips;
+    // of those, the ones that would have decided whether to walk
+    long walk_decisions_skipped;
+    // random walks and slave rebirths replayed on waking
+    long catchup_moves;
+} mob_sleep_stats;
+
 Species mobdb_searchname(MobName str);
 Species mobdb_checkid(Species id);
 BlockId mob_once_spawn(dumb_ptr<map_session_data> sd,
@@ -101,6 +114,8 @@ int mob_target(dumb_ptr<mob_data> md, dumb_ptr<block_list> bl, int dist);
 int mob_stop_walking(dumb_ptr<mob_data> md, int type);
 int mob_stopattack(dumb_ptr<mob_data>);
 int mob_spawn(BlockId);
+P<mob_spawn_group> mob_spawn_group_get(P<map_local> m,
+        short x0, short y0, short xs, short ys);
 int mob_damage(dumb_ptr<block_list>, dumb_ptr<mob_data>, int, int);
 int mob_heal(dumb_ptr<mob_data>, int);
 short mob_get_hair(Species);
@@ -39,4 +39,6 @@ extern
 Map<NpcEvent, struct event_data> ev_db;
 extern
 DMap<NpcName, dumb_ptr<npc_data>> npcs_by_name;
+
+void npc_event_add(NpcEvent key, struct event_data ev);
 } // namespace tmwa
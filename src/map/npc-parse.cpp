@@ -20,11 +20,18 @@
 //    You should have received a copy of the GNU General Public License
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include "../compat/nullpo.hpp"
 
 #include "../strings/astring.hpp"
+#include "../strings/mstring.hpp"
 #include "../strings/xstring.hpp"
 #include "../strings/literal.hpp"
 
@@ -33,6 +40,7 @@
 #include "../io/cxxstdio.hpp"
 #include "../io/extract.hpp"
 #include "../io/line.hpp"
+#include "../io/span.hpp"
 
 #include "../mmo/config_parse.hpp"
 
@@ -272,6 +280,8 @@ bool npc_load_monster(ast::npc::Monster& monster)
 
     P<map_local> m = TRY_UNWRAP(map_mapname2mapid(mapname), abort());
 
+    P<mob_spawn_group> group = mob_spawn_group_get(m, x, y, xs, ys);
+
     if (num > 1 && battle_config.mob_count_rate != 100)
     {
         num = num * battle_config.mob_count_rate / 100;
@@ -311,6 +321,7 @@ bool npc_load_monster(ast::npc::Monster& monster)
         md->spawn.ys = ys;
         md->spawn.delay1 = delay1;
         md->spawn.delay2 = delay2;
+        md->spawn.group = Some(group);
 
         really_memzero_this(&md->state);
         // md->timer = nullptr;
@@ -481,7 +492,7 @@ bool npc_load_script_none(ast::script::ScriptBody& body, ast::npc::ScriptNone& s
             NpcEvent buf;
             buf.npc = nd->name;
             buf.label = lname;
-            ev_db.insert(buf, ev);
+            npc_event_add(buf, ev);
         }
     }
 
@@ -569,7 +580,7 @@ bool npc_load_script_map_none(ast::script::ScriptBody& body, ast::npc::ScriptMap
         NpcEvent npcev;
         npcev.npc = nd->name;
         npcev.label = ScriptLabel();
-        ev_db.insert(npcev, ev);
+        npc_event_add(npcev, ev);
     }
 
     register_npc_name(nd);
@@ -590,7 +601,7 @@ bool npc_load_script_map_none(ast::script::ScriptBody& body, ast::npc::ScriptMap
             NpcEvent buf;
             buf.npc = nd->name;
             buf.label = lname;
-            ev_db.insert(buf, ev);
+            npc_event_add(buf, ev);
         }
     }
 
@@ -716,7 +727,7 @@ bool npc_load_script_map(ast::script::ScriptBody& body, ast::npc::ScriptMap& scr
             NpcEvent buf;
             buf.npc = nd->name;
             buf.label = lname;
-            ev_db.insert(buf, ev);
+            npc_event_add(buf, ev);
         }
     }
 
@@ -819,10 +830,59 @@ dumb_ptr<npc_data> npc_spawn_text(Borrowed<map_local> m, int x, int y,
     return retval;
 }
 
+// An NPC file read and split into top-level entries by a worker thread.
+// Only the ast is built there; names, labels, ev_db, the maps and
+// compile_script all use shared tables, so they stay in the serial pass.
+struct ParsedNpc
+{
+    // what parse_top would have printed to stderr
+    AString messages;
+    Option<Result<ast::npc::TopLevel>> res = None;
+};
+struct ParsedNpcFile
+{
+    // never shared with the main thread while a worker has it
+    AString path;
+    bool opened = false;
+    AString open_messages;
+    std::vector<ParsedNpc> entries;
+    bool ready = false;
+};
+
 static
-bool load_one_npc(io::LineCharReader& fp, bool& done)
+void npc_parse_file(ParsedNpcFile& file)
 {
-    auto res = TRY_UNWRAP(ast::npc::parse_top(fp), { done = true; return true; });
+    MString messages;
+    io::capture_messages(&messages);
+    {
+        io::LineCharReader fp(file.path);
+        file.opened = fp.is_open();
+        file.open_messages = AString(messages);
+        messages = MString();
+        while (file.opened)
+        {
+            ParsedNpc entry;
+            entry.res = ast::npc::parse_top(fp);
+            entry.messages = AString(messages);
+            messages = MString();
+            bool more = false;
+            if OPTION_IS_SOME(res, entry.res)
+                more = res.get_success().is_some();
+            file.entries.push_back(std::move(entry));
+            // the serial loader stops at the first thing it can't parse
+            if (!more)
+                break;
+        }
+    }
+    io::capture_messages(nullptr);
+}
+
+static
+bool load_one_npc(ParsedNpc& entry, bool& done)
+{
+    if (entry.messages)
+        io::print_message(entry.messages);
+    auto res = TRY_UNWRAP(std::move(entry.res), { done = true; return true; });
     if (res.get_failure())
         PRINTF("%s\n"_fmt, res.get_failure());
     ast::npc::TopLevel tl = TRY_UNWRAP(std::move(res.get_success()), return false);
@@ -887,37 +947,87 @@ bool load_one_npc(io::LineCharReader& fp, bool& done)
 }
 
 static
-bool load_npc_file(ZString nsl)
+bool load_npc_file(ParsedNpcFile& file)
 {
-    io::LineCharReader fp(nsl);
-    if (!fp.is_open())
+    if (file.open_messages)
+        io::print_message(file.open_messages);
+    if (!file.opened)
     {
-        PRINTF("file not found : %s\n"_fmt, nsl);
+        PRINTF("file not found : %s\n"_fmt, file.path);
         return false;
     }
     PRINTF("Loading NPCs [%d]: %-54s\r"_fmt, unwrap<BlockId>(npc_id) - unwrap<BlockId>(START_NPC_NUM),
-            nsl);
+            file.path);
 
     bool done = false;
-    while (!done)
+    for (ParsedNpc& entry : file.entries)
     {
-        if (!load_one_npc(fp, done))
+        if (!load_one_npc(entry, done))
             return false;
+        if (done)
+            break;
     }
     return true;
 }
 
+/*==========================================
+ * NPCファイルの読み込み
+ * Workers read and parse the files in any order; the loop below
+ * takes them strictly in configuration order, printing what each
+ * one printed, so ids, messages and errors come out exactly as a
+ * single-threaded load would produce them.
+ *------------------------------------------
+ */
 bool do_init_npc(void)
 {
     bool rv = true;
 
-    for (; !npc_srcs.empty(); npc_srcs.pop_front())
+    std::vector<ParsedNpcFile> files(npc_srcs.size());
+    auto fit = files.begin();
+    for (AString& nsl : npc_srcs)
+        (fit++)->path = AString(nsl.begin(), nsl.end());
+    npc_srcs.clear();
+
+    std::mutex ready_lock;
+    std::condition_variable ready_cond;
+    std::atomic<size_t> next_file(0);
+    auto parse_worker = [&]()
+    {
+        size_t i;
+        while ((i = next_file++) < files.size())
+        {
+            npc_parse_file(files[i]);
+            std::lock_guard<std::mutex> guard(ready_lock);
+            files[i].ready = true;
+            ready_cond.notify_all();
+        }
+    };
+    size_t nthreads = std::min<size_t>(files.size(),
+            std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < nthreads; i++)
+        workers.emplace_back(parse_worker);
+
+    for (ParsedNpcFile& file : files)
     {
-        AString nsl = npc_srcs.front();
-        rv &= load_npc_file(nsl);
+        {
+            std::unique_lock<std::mutex> guard(ready_lock);
+            ready_cond.wait(guard, [&file]() { return file.ready; });
+        }
+        rv &= load_npc_file(file);
+        file.entries.clear();
     }
+    for (std::thread& t : workers)
+        t.join();
     PRINTF("NPCs Loaded: %d [Warps:%d Shops:%d Scripts:%d Mobs:%d] %20s\n"_fmt,
             unwrap<BlockId>(npc_id) - unwrap<BlockId>(START_NPC_NUM), npc_warp, npc_shop, npc_script, npc_mob, ""_s);
+    if (battle_config.script_optimize)
+    {
+        const Script_Optimize_Stats& so = script_optimize_stats;
+        PRINTF("Scripts optimized: %ld, instructions %ld -> %ld [folded:%ld branches:%ld increments:%ld threaded:%ld dead:%ld]\n"_fmt,
+                so.scripts, so.insns_before, so.insns_after,
+                so.folded, so.branches, so.increments, so.threaded, so.dead);
+    }
 
     if (script_errors)
     {
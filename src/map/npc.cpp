@@ -24,7 +24,9 @@
 #include <ctime>
 
 #include <algorithm>
+#include <bitset>
 #include <list>
+#include <vector>
 
 #include "../compat/fun.hpp"
 #include "../compat/nullpo.hpp"
@@ -69,6 +71,23 @@ BlockId npc_get_new_npc_id(void)
 Map<NpcEvent, struct event_data> ev_db;
 DMap<NpcName, dumb_ptr<npc_data>> npcs_by_name;
 
+// label -> every event with that label, in ev_db order
+// rebuilt lazily after npc_event_add
+static
+Map<ScriptLabel, std::vector<P<struct event_data>>> ev_label_db;
+static
+bool ev_label_db_stale = true;
+
+// which clock labels at least one NPC listens to
+static
+struct EventCalendar
+{
+    std::bitset<60> minute;
+    std::bitset<24 * 60> clock;
+    std::bitset<24> hour;
+    std::bitset<12 * 32> day;
+} ev_calendar;
+
 // used for clock-based event triggers
 // only tm_min, tm_hour, and tm_mday are used
 static
@@ -221,64 +240,99 @@ void npc_timer_event(NpcEvent eventname)
 }
 
 /*==========================================
- * 全てのNPCのOn*イベント実行
+ * イベントの登録
+ *------------------------------------------
+ */
+void npc_event_add(NpcEvent key, struct event_data ev)
+{
+    ev_db.insert(key, ev);
+    ev_label_db_stale = true;
+}
+
+/*==========================================
+ * ラベル索引と時計イベント表の作成
  *------------------------------------------
  */
 static
-void npc_event_doall_sub(NpcEvent key, struct event_data *ev,
-        int *c, ScriptLabel name, BlockId rid, Slice<argrec_t> argv)
+void npc_event_index(void)
 {
-    ScriptLabel p = key.label;
+    if (!ev_label_db_stale)
+        return;
+    ev_label_db_stale = false;
 
-    nullpo_retv(ev);
+    ev_label_db.clear();
+    for (auto& pair : ev_db)
+        ev_label_db.init(pair.first.label)->push_back(borrow(pair.second));
 
-    if (name == p)
+    auto listened = [](ScriptLabel label)
+    {
+        return ev_label_db.search(label).is_some();
+    };
+    ScriptLabel buf;
+    ev_calendar = EventCalendar();
+    for (int h = 0; h < 24; h++)
     {
-        run_script_l(ScriptPointer(borrow(*ev->nd->scr.script), ev->pos), rid, ev->nd->bl_id,
-                argv);
-        (*c)++;
+        SNPRINTF(buf, 24, "OnHour%02d"_fmt, h);
+        ev_calendar.hour[h] = listened(buf);
+        for (int m = 0; m < 60; m++)
+        {
+            SNPRINTF(buf, 24, "OnClock%02d%02d"_fmt, h, m);
+            ev_calendar.clock[h * 60 + m] = listened(buf);
+        }
+    }
+    for (int m = 0; m < 60; m++)
+    {
+        SNPRINTF(buf, 24, "OnMinute%02d"_fmt, m);
+        ev_calendar.minute[m] = listened(buf);
+    }
+    for (int mon = 0; mon < 12; mon++)
+    {
+        for (int mday = 1; mday < 32; mday++)
+        {
+            SNPRINTF(buf, 24, "OnDay%02d%02d"_fmt, mon + 1, mday);
+            ev_calendar.day[mon * 32 + mday] = listened(buf);
+        }
     }
 }
 
+/*==========================================
+ * 全てのNPCのOn*イベント実行
+ *------------------------------------------
+ */
 int npc_event_doall_l(ScriptLabel name, BlockId rid, Slice<argrec_t> args)
 {
     int c = 0;
 
-    for (auto& pair : ev_db)
-        npc_event_doall_sub(pair.first, &pair.second, &c, name, rid, args);
-    return c;
-}
-
-static
-void npc_event_do_sub(NpcEvent key, struct event_data *ev,
-        int *c, NpcEvent name, BlockId rid, Slice<argrec_t> argv)
-{
-    nullpo_retv(ev);
-
-    if (name == key)
+    npc_event_index();
+    Option<P<std::vector<P<struct event_data>>>> evs_ = ev_label_db.search(name);
+    if OPTION_IS_SOME(evs, evs_)
     {
-        run_script_l(ScriptPointer(borrow(*ev->nd->scr.script), ev->pos), rid, ev->nd->bl_id,
-                argv);
-        (*c)++;
+        for (P<struct event_data> ev : *evs)
+        {
+            run_script_l(ScriptPointer(borrow(*ev->nd->scr.script), ev->pos), rid, ev->nd->bl_id,
+                    args);
+            c++;
+        }
     }
+    return c;
 }
 
 int npc_event_do_l(NpcEvent name, BlockId rid, Slice<argrec_t> args)
 {
-    int c = 0;
-
     if (!name.npc)
     {
         return npc_event_doall_l(name.label, rid, args);
     }
 
-    for (auto& pair : ev_db)
-        npc_event_do_sub(pair.first, &pair.second, &c, name, rid, args);
-    return c;
+    P<struct event_data> ev = TRY_UNWRAP(ev_db.search(name), return 0);
+    run_script_l(ScriptPointer(borrow(*ev->nd->scr.script), ev->pos), rid, ev->nd->bl_id,
+            args);
+    return 1;
 }
 
 /*==========================================
  * 時計イベント実行
+ * Only labels found by npc_event_index are formatted and run.
  *------------------------------------------
  */
 static
@@ -286,23 +340,36 @@ void npc_event_do_clock(TimerData *, tick_t)
 {
     struct tm t = TimeT::now();
 
+    npc_event_index();
     ScriptLabel buf;
     if (t.tm_min != ev_tm_b.tm_min)
     {
-        SNPRINTF(buf, 24, "OnMinute%02d"_fmt, t.tm_min);
-        npc_event_doall(buf);
-        SNPRINTF(buf, 24, "OnClock%02d%02d"_fmt, t.tm_hour, t.tm_min);
-        npc_event_doall(buf);
+        if (ev_calendar.minute[t.tm_min])
+        {
+            SNPRINTF(buf, 24, "OnMinute%02d"_fmt, t.tm_min);
+            npc_event_doall(buf);
+        }
+        if (ev_calendar.clock[t.tm_hour * 60 + t.tm_min])
+        {
+            SNPRINTF(buf, 24, "OnClock%02d%02d"_fmt, t.tm_hour, t.tm_min);
+            npc_event_doall(buf);
+        }
     }
     if (t.tm_hour != ev_tm_b.tm_hour)
     {
-        SNPRINTF(buf, 24, "OnHour%02d"_fmt, t.tm_hour);
-        npc_event_doall(buf);
+        if (ev_calendar.hour[t.tm_hour])
+        {
+            SNPRINTF(buf, 24, "OnHour%02d"_fmt, t.tm_hour);
+            npc_event_doall(buf);
+        }
     }
     if (t.tm_mday != ev_tm_b.tm_mday)
     {
-        SNPRINTF(buf, 24, "OnDay%02d%02d"_fmt, t.tm_mon + 1, t.tm_mday);
-        npc_event_doall(buf);
+        if (ev_calendar.day[t.tm_mon * 32 + t.tm_mday])
+        {
+            SNPRINTF(buf, 24, "OnDay%02d%02d"_fmt, t.tm_mon + 1, t.tm_mday);
+            npc_event_doall(buf);
+        }
     }
     ev_tm_b = t;
 }
@@ -955,6 +1022,7 @@ void npc_free(dumb_ptr<npc_data> nd)
     npc_propagate_update(nd);
     map_deliddb(nd);
     map_delblock(nd);
+    script_slice_drop(nd->bl_id);
     npc_free_internal(nd);
 }
 } // namespace tmwa
@@ -25,6 +25,7 @@
 #include <cassert>
 
 #include <algorithm>
+#include <deque>
 
 #include "../compat/fun.hpp"
 #include "../compat/nullpo.hpp"
@@ -34,6 +35,7 @@
 #include "../strings/zstring.hpp"
 #include "../strings/literal.hpp"
 
+#include "../generic/intern-pool.hpp"
 #include "../generic/random.hpp"
 
 #include "../io/cxxstdio.hpp"
@@ -58,6 +60,7 @@
 #include "party.hpp"
 #include "path.hpp"
 #include "script-call.hpp"
+#include "script-parse-internal.hpp"
 #include "skill.hpp"
 #include "storage.hpp"
 #include "trade.hpp"
@@ -601,6 +604,36 @@ int pc_isequip(dumb_ptr<map_session_data> sd, IOff0 n)
     return 1;
 }
 
+static
+int pc_globalreg_slot(dumb_ptr<map_session_data> sd, size_t var)
+{
+    if (var >= sd->global_reg_slot.size())
+        return -1;
+    return sd->global_reg_slot[var] - 1;
+}
+
+static
+void pc_set_globalreg_slot(dumb_ptr<map_session_data> sd, size_t var, int slot)
+{
+    if (var >= sd->global_reg_slot.size())
+        sd->global_reg_slot.resize(var + 1);
+    sd->global_reg_slot[var] = slot + 1;
+}
+
+/*==========================================
+ * グローバル変数の索引を作る
+ * global_reg[] is what the char server sends and saves; the index maps
+ * an interned variable name straight to its slot.
+ *------------------------------------------
+ */
+static
+void pc_index_globalreg(dumb_ptr<map_session_data> sd)
+{
+    sd->global_reg_slot.clear();
+    for (int i = 0; i < sd->status.global_reg_num; i++)
+        pc_set_globalreg_slot(sd, variable_names.intern(sd->status.global_reg[i].str), i);
+}
+
 /*==========================================
  * session idに問題無し
  * char鯖から送られてきたステータスを設定
@@ -622,6 +655,7 @@ int pc_authok(AccountId id, int login_id2, TimeT connect_until_time,
 
     sd->status_key = *st_key;
     sd->status = *st_data;
+    pc_index_globalreg(sd);
 
     if (sd->status.sex != sd->sex)
     {
@@ -728,6 +762,7 @@ int pc_authok(AccountId id, int login_id2, TimeT connect_until_time,
 
     clif_authok(sd);
     map_addnickdb(sd);
+    pc_autosave_add(sd);
     if (!map_charid2nick(sd->status_key.char_id).to__actual())
         map_addchariddb(sd->status_key.char_id, sd->status_key.name);
 
@@ -4012,75 +4047,84 @@ void pc_setregstr(dumb_ptr<map_session_data> sd, SIR reg, RString str)
  * script用グローバル変数の値を読む
  *------------------------------------------
  */
-int pc_readglobalreg(dumb_ptr<map_session_data> sd, VarName reg)
+int pc_readglobalreg(dumb_ptr<map_session_data> sd, SIR reg)
 {
-    int i;
-
     nullpo_retz(sd);
 
-    assert (sd->status.global_reg_num < GLOBAL_REG_NUM);
-    for (i = 0; i < sd->status.global_reg_num; i++)
-    {
-        if (sd->status.global_reg[i].str == reg)
-            return sd->status.global_reg[i].value;
-    }
+    int i = pc_globalreg_slot(sd, reg.base());
+    if (i < 0)
+        return 0;
+    return sd->status.global_reg[i].value;
+}
 
-    return 0;
+int pc_readglobalreg(dumb_ptr<map_session_data> sd, VarName reg)
+{
+    return pc_readglobalreg(sd, SIR::from(variable_names.intern(reg)));
 }
 
 /*==========================================
  * script用グローバル変数の値を設定
  *------------------------------------------
  */
-int pc_setglobalreg(dumb_ptr<map_session_data> sd, VarName reg, int val)
+int pc_setglobalreg(dumb_ptr<map_session_data> sd, SIR reg, int val)
 {
-    int i;
+    static
+    size_t die_counter_var = variable_names.intern("PC_DIE_COUNTER"_s);
 
     nullpo_retz(sd);
 
+    size_t var = reg.base();
+
     //PC_DIE_COUNTERがスクリプトなどで変更された時の処理
-    if (reg == stringish<VarName>("PC_DIE_COUNTER"_s) && sd->die_counter != val)
+    if (var == die_counter_var && sd->die_counter != val)
     {
         sd->die_counter = val;
         pc_calcstatus(sd, 0);
     }
     assert (sd->status.global_reg_num < GLOBAL_REG_NUM);
+    int i = pc_globalreg_slot(sd, var);
     if (val == 0)
     {
-        for (i = 0; i < sd->status.global_reg_num; i++)
+        if (i >= 0)
         {
-            if (sd->status.global_reg[i].str == reg)
+            int last = sd->status.global_reg_num - 1;
+            sd->global_reg_slot[var] = 0;
+            if (i != last)
             {
-                sd->status.global_reg[i] =
-                    sd->status.global_reg[sd->status.global_reg_num - 1];
-                sd->status.global_reg_num--;
-                break;
+                sd->status.global_reg[i] = sd->status.global_reg[last];
+                pc_set_globalreg_slot(sd, variable_names.intern(sd->status.global_reg[i].str), i);
             }
+            sd->status.global_reg_num--;
         }
         return 0;
     }
-    for (i = 0; i < sd->status.global_reg_num; i++)
+    if (i >= 0)
     {
-        if (sd->status.global_reg[i].str == reg)
-        {
-            sd->status.global_reg[i].value = val;
-            return 0;
-        }
+        sd->status.global_reg[i].value = val;
+        return 0;
     }
+    VarName name = stringish<VarName>(variable_names.outtern(var));
     if (sd->status.global_reg_num < GLOBAL_REG_NUM)
     {
-        sd->status.global_reg[i].str = reg;
+        i = sd->status.global_reg_num;
+        sd->status.global_reg[i].str = name;
         sd->status.global_reg[i].value = val;
         sd->status.global_reg_num++;
+        pc_set_globalreg_slot(sd, var, i);
         return 0;
     }
     if (battle_config.error_log)
         PRINTF("pc_setglobalreg : couldn't set %s (GLOBAL_REG_NUM = %d)\n"_fmt,
-                reg, GLOBAL_REG_NUM);
+                name, GLOBAL_REG_NUM);
 
     return 1;
 }
 
+int pc_setglobalreg(dumb_ptr<map_session_data> sd, VarName reg, int val)
+{
+    return pc_setglobalreg(sd, SIR::from(variable_names.intern(reg)), val);
+}
+
 /*==========================================
  * script用アカウント変数の値を読む
  *------------------------------------------
@@ -4989,46 +5033,88 @@ void pc_setsavepoint(dumb_ptr<map_session_data> sd, MapName mapname, int x, int
 }
 
 /*==========================================
- * 自動セーブ 各クライアント
+ * 自動セーブ
+ * Every online player is visited once per autosave_time, in login
+ * order, autosave_batch of them per tick.  Players who logged out
+ * are dropped from the queue when their turn comes.
  *------------------------------------------
  */
 static
-int last_save_fd, save_flag;
+std::deque<BlockId> autosave_queue;
 static
-void pc_autosave_sub(dumb_ptr<map_session_data> sd)
-{
-    nullpo_retv(sd);
-
-    if (save_flag == 0 && sd->sess->fd.uncast_dammit() > last_save_fd)
-    {
-        pc_makesavestatus(sd);
-        chrif_save(sd);
+long autosave_saved, autosave_skipped;
+static
+interval_t autosave_age_total, autosave_age_max;
 
-        save_flag = 1;
-        last_save_fd = sd->sess->fd.uncast_dammit();
-    }
+void pc_autosave_add(dumb_ptr<map_session_data> sd)
+{
+    sd->last_save = gettick();
+    // a quick relogin keeps its old place
+    if (std::find(autosave_queue.begin(), autosave_queue.end(), sd->bl_id) == autosave_queue.end())
+        autosave_queue.push_back(sd->bl_id);
 }
 
-/*==========================================
- * 自動セーブ (timer関数)
- *------------------------------------------
- */
 static
-void pc_autosave(TimerData *, tick_t)
+void pc_autosave(TimerData *, tick_t tick)
 {
-    save_flag = 0;
-    clif_foreachclient(pc_autosave_sub);
-    if (save_flag == 0)
-        last_save_fd = -1;
+    for (int i = 0; i < autosave_batch && !autosave_queue.empty(); ++i)
+    {
+        BlockId id = autosave_queue.front();
+        autosave_queue.pop_front();
+        dumb_ptr<map_session_data> sd = map_id2sd(id);
+        if (!sd || !sd->state.auth)
+            continue;
+        autosave_queue.push_back(id);
+
+        interval_t age = tick - sd->last_save;
+        if (chrif_save(sd) == 1)
+        {
+            autosave_skipped++;
+            continue;
+        }
+        autosave_saved++;
+        autosave_age_total += age;
+        autosave_age_max = std::max(autosave_age_max, age);
+    }
 
-    interval_t interval = autosave_time / (clif_countusers() + 1);
+    interval_t interval = autosave_time * autosave_batch / (autosave_queue.size() + 1);
     if (interval <= interval_t::zero())
         interval = 1_ms;
-    Timer(gettick() + interval,
+    Timer(tick + interval,
             pc_autosave
     ).detach();
 }
 
+std::vector<AString> pc_autosave_report(void)
+{
+    std::vector<AString> out;
+    tick_t now = gettick();
+    interval_t oldest = interval_t::zero();
+    for (BlockId id : autosave_queue)
+    {
+        dumb_ptr<map_session_data> sd = map_id2sd(id);
+        if (sd && sd->state.auth)
+            oldest = std::max(oldest, now - sd->last_save);
+    }
+    namespace c = std::chrono;
+    out.push_back(STRPRINTF("Autosave: %zu queued, every %ld s, %d per tick."_fmt,
+                autosave_queue.size(),
+                c::duration_cast<c::seconds>(autosave_time).count(),
+                autosave_batch));
+    out.push_back(STRPRINTF("%ld saved, %ld unchanged; time since last save: average %ld ms, longest %ld ms, now %ld ms."_fmt,
+                autosave_saved, autosave_skipped,
+                autosave_saved ? autosave_age_total.count() / autosave_saved : 0,
+                autosave_age_max.count(),
+                oldest.count()));
+    return out;
+}
+
+void pc_autosave_reset(void)
+{
+    autosave_saved = autosave_skipped = 0;
+    autosave_age_total = autosave_age_max = interval_t::zero();
+}
+
 int pc_read_gm_account(Session *, const std::vector<Packet_Repeat<0x2b15>>& repeat)
 {
     gm_accountm.clear();
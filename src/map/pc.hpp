@@ -24,6 +24,10 @@
 
 #include "fwd.hpp"
 
+#include <vector>
+
+#include "../strings/astring.hpp"
+
 #include "../generic/dumb_ptr.hpp"
 
 #include "../mmo/clif.t.hpp"
@@ -149,7 +153,9 @@ void pc_setreg(dumb_ptr<map_session_data>, SIR, int);
 ZString pc_readregstr(dumb_ptr<map_session_data> sd, SIR reg);
 void pc_setregstr(dumb_ptr<map_session_data> sd, SIR reg, RString str);
 int pc_readglobalreg(dumb_ptr<map_session_data>, VarName );
+int pc_readglobalreg(dumb_ptr<map_session_data>, SIR);
 int pc_setglobalreg(dumb_ptr<map_session_data>, VarName , int);
+int pc_setglobalreg(dumb_ptr<map_session_data>, SIR, int);
 int pc_readaccountreg(dumb_ptr<map_session_data>, VarName );
 int pc_setaccountreg(dumb_ptr<map_session_data>, VarName , int);
 int pc_readaccountreg2(dumb_ptr<map_session_data>, VarName );
@@ -177,5 +183,10 @@ int pc_logout(dumb_ptr<map_session_data> sd);   // [fate] Player logs out
 
 void pc_show_motd(dumb_ptr<map_session_data> sd);
 
+void pc_autosave_add(dumb_ptr<map_session_data> sd);
+/// Queue length and save counters, for @autosave.
+std::vector<AString> pc_autosave_report(void);
+void pc_autosave_reset(void);
+
 void do_init_pc(void);
 } // namespace tmwa
@@ -52,6 +52,11 @@ public:
     BlockId rid, oid;
     ScriptPointer scriptp, new_scriptp;
     int defsp, new_defsp;
+    // may be suspended between statements when its slice runs out
+    bool can_yield;
+    // started without a player; if it attachrid's one, it only yields
+    // once detached again, so it never resumes to find the player gone
+    bool detached;
 };
 
 void run_func(ScriptState *st);
@@ -64,6 +69,7 @@ enum class ScriptEndState
     RERUNLINE,
     GOTO,
     RETFUNC,
+    YIELD,
 };
 
 dumb_ptr<map_session_data> script_rid2sd(ScriptState *st);
@@ -22,10 +22,19 @@
 //    You should have received a copy of the GNU General Public License
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include "../compat/memory.hpp"
+
 #include "../generic/intern-pool.hpp"
 
 #include "../io/cxxstdio.hpp"
 
+#include "../net/timer.hpp"
+
 #include "../mmo/cxxstdio_enums.hpp"
 
 #include "battle.hpp"
@@ -35,6 +44,7 @@
 #include "script-fun.hpp"
 #include "script-parse-internal.hpp"
 #include "script-persist.hpp"
+#include "script-profile.hpp"
 #include "script-startup-internal.hpp"
 
 #include "../poison.hpp"
@@ -53,6 +63,60 @@ struct ScriptConfigRun
     int check_gotocount = 512;
 } script_config;
 
+// run_script_l nests (builtins can fire events), so this is a free list.
+// Recycled stacks keep their capacity, and so does npc_stackbuf, since a
+// paused dialog swaps buffers with the stack instead of copying it.
+static
+std::vector<std::unique_ptr<script_stack>> script_stack_pool;
+
+static
+std::unique_ptr<script_stack> script_stack_get(void)
+{
+    if (script_stack_pool.empty())
+    {
+        auto stack = make_unique<script_stack>();
+        stack->stack_datav.reserve(64);
+        return stack;
+    }
+    std::unique_ptr<script_stack> stack = std::move(script_stack_pool.back());
+    script_stack_pool.pop_back();
+    return stack;
+}
+
+static
+void script_stack_put(std::unique_ptr<script_stack> stack)
+{
+    stack->stack_datav.clear();
+    script_stack_pool.push_back(std::move(stack));
+}
+
+// Scripts that used up battle_config.script_slice instructions and were
+// suspended between two statements.  Each gets one more slice per tick.
+struct ScriptContinuation
+{
+    std::unique_ptr<script_stack> stack;
+    ScriptPointer scriptp;
+    P<const ScriptBuffer> rootscript;
+    BlockId rid, oid;
+    bool detached;
+};
+static
+std::vector<ScriptContinuation> script_continuations;
+static
+Timer script_slice_timer;
+
+static
+void script_slice_resume(TimerData *, tick_t);
+
+static
+void script_slice_push(std::unique_ptr<script_stack> stack, ScriptState *st,
+        Borrowed<const ScriptBuffer> rootscript)
+{
+    script_continuations.push_back(ScriptContinuation{std::move(stack), st->scriptp, rootscript, st->rid, st->oid, st->detached});
+    if (!script_slice_timer)
+        script_slice_timer = Timer(gettick() + 1_ms, script_slice_resume);
+}
+
 
 /*==========================================
  * ridからsdへの解決
@@ -87,66 +151,60 @@ void get_val(dumb_ptr<map_session_data> sd, struct script_data *data)
         }
         CASE (const ScriptDataVariable&, u)
         {
-            ZString name_ = variable_names.outtern(u.reg.base());
-            VarName name = stringish<VarName>(name_);
-            char prefix = name.front();
-            char postfix = name.back();
+            VariableKind kind = variable_kind(u.reg.base());
 
-            if (prefix != '$')
+            if (kind.scope != VariableScope::MAPREG)
             {
                 if (sd == nullptr)
-                    PRINTF("get_val error name?:%s\n"_fmt, name);
+                    PRINTF("get_val error name?:%s\n"_fmt, variable_names.outtern(u.reg.base()));
             }
-            if (postfix == '$')
+            if (kind.str)
             {
                 RString str;
-                if (prefix == '@')
+                switch (kind.scope)
                 {
+                case VariableScope::TEMP:
                     if (sd)
                         str = pc_readregstr(sd, u.reg);
-                }
-                else if (prefix == '$')
+                    break;
+                case VariableScope::MAPREG:
                 {
                     Option<P<RString>> s_ = mapregstr_db.search(u.reg);
                     if OPTION_IS_SOME(s, s_)
                         str = *s;
                 }
-                else
-                {
+                    break;
+                default:
                     PRINTF("script: get_val: illegal scope string variable.\n"_fmt);
                     str = "!!ERROR!!"_s;
+                    break;
                 }
                 *data = ScriptDataStr{str};
             }
             else
             {
                 int numi = 0;
-                if (prefix == '@')
+                switch (kind.scope)
                 {
+                case VariableScope::TEMP:
                     if (sd)
                         numi = pc_readreg(sd, u.reg);
-                }
-                else if (prefix == '$')
-                {
+                    break;
+                case VariableScope::MAPREG:
                     numi = mapreg_db.get(u.reg);
-                }
-                else if (prefix == '#')
-                {
-                    if (name[1] == '#')
-                    {
-                        if (sd)
-                            numi = pc_readaccountreg2(sd, name);
-                    }
-                    else
-                    {
-                        if (sd)
-                            numi = pc_readaccountreg(sd, name);
-                    }
-                }
-                else
-                {
+                    break;
+                case VariableScope::ACCOUNT2:
+                    if (sd)
+                        numi = pc_readaccountreg2(sd, stringish<VarName>(variable_names.outtern(u.reg.base())));
+                    break;
+                case VariableScope::ACCOUNT:
+                    if (sd)
+                        numi = pc_readaccountreg(sd, stringish<VarName>(variable_names.outtern(u.reg.base())));
+                    break;
+                case VariableScope::GLOBAL:
                     if (sd)
-                        numi = pc_readglobalreg(sd, name);
+                        numi = pc_readglobalreg(sd, u.reg);
+                    break;
                 }
                 *data = ScriptDataInt{numi};
             }
@@ -185,48 +243,44 @@ void set_reg(dumb_ptr<map_session_data> sd, VariableCode type, SIR reg, struct s
     }
     assert (type == VariableCode::VARIABLE);
 
-    ZString name_ = variable_names.outtern(reg.base());
-    VarName name = stringish<VarName>(name_);
-    char prefix = name.front();
-    char postfix = name.back();
+    VariableKind kind = variable_kind(reg.base());
 
-    if (postfix == '$')
+    if (kind.str)
     {
         RString str = vd.get_if<ScriptDataStr>()->str;
-        if (prefix == '@')
+        switch (kind.scope)
         {
+        case VariableScope::TEMP:
             pc_setregstr(sd, reg, str);
-        }
-        else if (prefix == '$')
-        {
+            break;
+        case VariableScope::MAPREG:
             mapreg_setregstr(reg, str);
-        }
-        else
-        {
+            break;
+        default:
             PRINTF("script: set_reg: illegal scope string variable !"_fmt);
+            break;
         }
     }
     else
     {
         int val = vd.get_if<ScriptDataInt>()->numi;
-        if (prefix == '@')
+        switch (kind.scope)
         {
+        case VariableScope::TEMP:
             pc_setreg(sd, reg, val);
-        }
-        else if (prefix == '$')
-        {
+            break;
+        case VariableScope::MAPREG:
             mapreg_setreg(reg, val);
-        }
-        else if (prefix == '#')
-        {
-            if (name[1] == '#')
-                pc_setaccountreg2(sd, name, val);
-            else
-                pc_setaccountreg(sd, name, val);
-        }
-        else
-        {
-            pc_setglobalreg(sd, name, val);
+            break;
+        case VariableScope::ACCOUNT2:
+            pc_setaccountreg2(sd, stringish<VarName>(variable_names.outtern(reg.base())), val);
+            break;
+        case VariableScope::ACCOUNT:
+            pc_setaccountreg(sd, stringish<VarName>(variable_names.outtern(reg.base())), val);
+            break;
+        case VariableScope::GLOBAL:
+            pc_setglobalreg(sd, reg, val);
+            break;
         }
     }
 }
@@ -311,41 +365,6 @@ void pop_stack(struct script_stack *stack, int start, int end)
 //
 // 実行部main
 //
-/*==========================================
- * コマンドの読み取り
- *------------------------------------------
- */
-static
-ByteCode get_com(ScriptPointer *script)
-{
-    if (static_cast<uint8_t>(script->peek()) >= 0x80)
-    {
-        // synthetic! Does not advance pos yet.
-        return ByteCode::INT;
-    }
-    return script->pop();
-}
-
-/*==========================================
- * 数値の所得
- *------------------------------------------
- */
-static
-int get_num(ScriptPointer *scr)
-{
-    int i = 0;
-    int j = 0;
-    uint8_t val;
-    do
-    {
-        val = static_cast<uint8_t>(scr->pop());
-        i += (val & 0x7f) << j;
-        j += 6;
-    }
-    while (val >= 0xc0);
-    return i;
-}
-
 /*==========================================
  * スタックから値を取り出す
  *------------------------------------------
@@ -392,6 +411,24 @@ void op_add(ScriptState *st)
     {
         RString sb = conv_str(st, &back);
         RString sb1 = conv_str(st, &back1);
+        if (!sb)
+            return;
+        if (!sb1)
+        {
+            back1 = ScriptDataStr{.str= sb};
+            return;
+        }
+        // most concatenations are short dialog fragments: build them
+        // on the stack and allocate the result once
+        char small[256];
+        size_t len = sb1.size() + sb.size();
+        if (len <= sizeof(small))
+        {
+            std::copy(sb.begin(), sb.end(),
+                    std::copy(sb1.begin(), sb1.end(), small));
+            back1 = ScriptDataStr{.str= RString(small, small + len)};
+            return;
+        }
         MString buf;
         buf += sb1;
         buf += sb;
@@ -533,6 +570,27 @@ void op_2(ScriptState *st, ByteCode op)
     }
 }
 
+/*==========================================
+ * set x, x + k (fused by the optimizer)
+ * Reads and writes the variable the same way builtin_set would.
+ *------------------------------------------
+ */
+static
+void op_inc(ScriptState *st, VariableCode type, SIR reg, int k)
+{
+    script_data d = ScriptDataVariable{reg};
+    if (type == VariableCode::PARAM)
+        d = ScriptDataParam{reg};
+    get_val(st, &d);
+    int val = d.get_if<ScriptDataInt>()->numi + k;
+
+    dumb_ptr<map_session_data> sd = nullptr;
+    if (type == VariableCode::PARAM
+            || variable_kind(reg.base()).scope != VariableScope::MAPREG)
+        sd = script_rid2sd(st);
+    set_reg(sd, type, reg, val);
+}
+
 /*==========================================
  * 単項演算子
  *------------------------------------------
@@ -638,7 +696,14 @@ void run_func(ScriptState *st)
         }
         PRINTF("\n"_fmt);
     }
-    builtin_functions[func].func(st);
+    if (battle_config.script_profile)
+    {
+        auto start = std::chrono::steady_clock::now();
+        builtin_functions[func].func(st);
+        script_profile_builtin(func, std::chrono::steady_clock::now() - start);
+    }
+    else
+        builtin_functions[func].func(st);
 
     pop_stack(st->stack, start_sp, end_sp);
 
@@ -676,7 +741,13 @@ void run_func(ScriptState *st)
 static
 void run_script_main(ScriptState *st, Borrowed<const ScriptBuffer> rootscript)
 {
-    int cmdcount = script_config.check_cmdcount;
+    // With a slice, running out of instructions or gotos suspends the
+    // script at the end of the statement instead of killing it.
+    int slice = st->can_yield ? battle_config.script_slice : 0;
+    int cmdlimit = slice ? slice : script_config.check_cmdcount;
+    int cmdcount = cmdlimit;
+    int cmdspent = 0;
+    bool yield_due = false;
     int gotocount = script_config.check_gotocount;
     struct script_stack *stack = st->stack;
 
@@ -684,122 +755,177 @@ void run_script_main(ScriptState *st, Borrowed<const ScriptBuffer> rootscript)
 
     int rerun_pos = st->scriptp.pos;
     st->state = ScriptEndState::ZERO;
-    while (st->state == ScriptEndState::ZERO)
+
+    // includes the time of any script run from inside this one
+    bool profile = battle_config.script_profile;
+    size_t profile_pos = st->scriptp.pos;
+    std::chrono::steady_clock::time_point profile_start;
+    if (profile)
+        profile_start = std::chrono::steady_clock::now();
+
+    // Indexed by ByteCode; must be kept in the same order as the enum.
+    static
+    const void *const dispatch[] =
+    {
+        &&insn_nop, &&insn_pos, &&insn_int, &&insn_param, &&insn_func, &&insn_str, &&insn_arg,
+        &&insn_variable, &&insn_eol,
+
+        &&insn_binary, &&insn_binary, &&insn_binary, &&insn_binary, &&insn_binary, &&insn_binary, &&insn_binary, &&insn_binary,
+        &&insn_binary, &&insn_binary, &&insn_binary, &&insn_add, &&insn_binary, &&insn_binary, &&insn_binary, &&insn_binary,
+        &&insn_unary, &&insn_unary, &&insn_unary, &&insn_binary, &&insn_binary,
+
+        &&insn_func_ref,
+
+        &&insn_inc_variable, &&insn_inc_param,
+    };
+    static_assert(sizeof(dispatch) / sizeof(dispatch[0]) == static_cast<size_t>(ByteCode::INC_PARAM) + 1,
+            "dispatch table out of sync with ByteCode");
+
+    P<const ScriptBuffer> code = TRY_UNWRAP(st->scriptp.code, abort());
+    P<const ScriptBuffer> profile_code = code;
+    const ScriptCode *ip = script_decoded_at(code, st->scriptp.pos);
+    if (!ip)
+        goto bad_pos;
+
+#define DISPATCH()                                              \
+    do                                                          \
+    {                                                           \
+        if (cmdcount > 0 && (--cmdcount) <= 0)                  \
+            goto slice_over;                                    \
+        goto *dispatch[static_cast<uint8_t>(ip->op)];           \
+    }                                                           \
+    while (0)
+#define NEXT()                                                  \
+    do                                                          \
+    {                                                           \
+        ++ip;                                                   \
+        DISPATCH();                                             \
+    }                                                           \
+    while (0)
+
+    goto *dispatch[static_cast<uint8_t>(ip->op)];
+
+insn_eol:
+    if (stack->stack_datav.size() != st->defsp)
+    {
+        if (true)
+            PRINTF("stack.sp (%zu) != default (%d)\n"_fmt,
+                    stack->stack_datav.size(),
+                    st->defsp);
+        abort();
+    }
+    rerun_pos = ip->next;
+    if (yield_due && (!st->detached || !st->rid))
+    {
+        st->scriptp.pos = ip->next;
+        st->state = ScriptEndState::YIELD;
+        goto done;
+    }
+    NEXT();
+insn_int:
+    push_int<ScriptDataInt>(stack, ip->arg);
+    NEXT();
+insn_pos:
+    push_int<ScriptDataPos>(stack, ip->arg);
+    NEXT();
+insn_variable:
+    push_reg<ScriptDataVariable>(stack, SIR::from(ip->arg));
+    NEXT();
+insn_func_ref:
+    push_int<ScriptDataFuncRef>(stack, ip->arg);
+    NEXT();
+insn_param:
+    push_reg<ScriptDataParam>(stack, SIR::from(static_cast<SP>(ip->arg)));
+    NEXT();
+insn_arg:
+    push_int<ScriptDataArg>(stack, 0);
+    NEXT();
+insn_str:
+    push_str<ScriptDataStr>(stack, script_const_str(code, ip->arg));
+    NEXT();
+insn_func:
+    // builtins read and write the byte position (callsub, goto, return)
+    st->scriptp.pos = ip->next;
+    run_func(st);
+    if (st->state == ScriptEndState::GOTO)
     {
-        switch (ByteCode c = get_com(&st->scriptp))
+        rerun_pos = st->scriptp.pos;
+        st->state = ScriptEndState::ZERO;
+        if (gotocount > 0 && (--gotocount) <= 0)
         {
-            case ByteCode::EOL:
-                if (stack->stack_datav.size() != st->defsp)
-                {
-                    if (true)
-                        PRINTF("stack.sp (%zu) != default (%d)\n"_fmt,
-                                stack->stack_datav.size(),
-                                st->defsp);
-                    abort();
-                }
-                rerun_pos = st->scriptp.pos;
-                break;
-            case ByteCode::INT:
-                // synthesized!
-                push_int<ScriptDataInt>(stack, get_num(&st->scriptp));
-                break;
-
-            case ByteCode::POS:
-            case ByteCode::VARIABLE:
-            case ByteCode::FUNC_REF:
-            case ByteCode::PARAM:
-                // Note that these 3 have *very* different meanings,
-                // despite being encoded similarly.
+            // a jump always lands on the start of a statement
+            if (slice && (!st->detached || !st->rid))
             {
-                int arg = 0;
-                arg |= static_cast<uint8_t>(st->scriptp.pop()) << 0;
-                arg |= static_cast<uint8_t>(st->scriptp.pop()) << 8;
-                arg |= static_cast<uint8_t>(st->scriptp.pop()) << 16;
-                switch(c)
-                {
-                case ByteCode::POS:
-                    push_int<ScriptDataPos>(stack, arg);
-                    break;
-                case ByteCode::VARIABLE:
-                    push_reg<ScriptDataVariable>(stack, SIR::from(arg));
-                    break;
-                case ByteCode::FUNC_REF:
-                    push_int<ScriptDataFuncRef>(stack, arg);
-                    break;
-                case ByteCode::PARAM:
-                    SP arg_sp = static_cast<SP>(arg);
-                    push_reg<ScriptDataParam>(stack, SIR::from(arg_sp));
-                    break;
-                }
+                st->state = ScriptEndState::YIELD;
+                goto done;
             }
-                break;
-            case ByteCode::ARG:
-                push_int<ScriptDataArg>(stack, 0);
-                break;
-            case ByteCode::STR:
-                push_str<ScriptDataStr>(stack, st->scriptp.pops());
-                break;
-            case ByteCode::FUNC:
-                run_func(st);
-                if (st->state == ScriptEndState::GOTO)
-                {
-                    rerun_pos = st->scriptp.pos;
-                    st->state = ScriptEndState::ZERO;
-                    if (gotocount > 0 && (--gotocount) <= 0)
-                    {
-                        PRINTF("run_script: infinity loop !\n"_fmt);
-                        st->state = ScriptEndState::END;
-                    }
-                }
-                break;
-
-            case ByteCode::ADD:
-                op_add(st);
-                break;
-
-            case ByteCode::SUB:
-            case ByteCode::MUL:
-            case ByteCode::DIV:
-            case ByteCode::MOD:
-            case ByteCode::EQ:
-            case ByteCode::NE:
-            case ByteCode::GT:
-            case ByteCode::GE:
-            case ByteCode::LT:
-            case ByteCode::LE:
-            case ByteCode::AND:
-            case ByteCode::OR:
-            case ByteCode::XOR:
-            case ByteCode::LAND:
-            case ByteCode::LOR:
-            case ByteCode::R_SHIFT:
-            case ByteCode::L_SHIFT:
-                op_2(st, c);
-                break;
-
-            case ByteCode::NEG:
-            case ByteCode::NOT:
-            case ByteCode::LNOT:
-                op_1num(st, c);
-                break;
-
-            case ByteCode::NOP:
-                st->state = ScriptEndState::END;
-                break;
-
-            default:
-                if (battle_config.error_log)
-                    PRINTF("unknown command : %d @ %zu\n"_fmt,
-                            c, st->scriptp.pos);
+            if (slice && !yield_due)
+            {
+                // attachrid'd: yield at the end of a statement without
+                // the player, under the normal guard until then
+                yield_due = true;
+                cmdspent = cmdlimit - cmdcount;
+                cmdlimit = script_config.check_cmdcount;
+                cmdcount = cmdlimit;
+                gotocount = script_config.check_gotocount;
+            }
+            else
+            {
+                PRINTF("run_script: infinity loop !\n"_fmt);
                 st->state = ScriptEndState::END;
-                break;
-        }
-        if (cmdcount > 0 && (--cmdcount) <= 0)
-        {
-            PRINTF("run_script: infinity loop !\n"_fmt);
-            st->state = ScriptEndState::END;
+                goto done;
+            }
         }
+        code = TRY_UNWRAP(st->scriptp.code, abort());
+        ip = script_decoded_at(code, st->scriptp.pos);
+        if (!ip)
+            goto bad_pos;
+        DISPATCH();
+    }
+    if (st->state != ScriptEndState::ZERO)
+        goto done;
+    NEXT();
+insn_add:
+    op_add(st);
+    NEXT();
+insn_binary:
+    op_2(st, ip->op);
+    NEXT();
+insn_unary:
+    op_1num(st, ip->op);
+    NEXT();
+insn_inc_variable:
+    op_inc(st, VariableCode::VARIABLE, SIR::from(ip->arg), ip->arg2);
+    NEXT();
+insn_inc_param:
+    op_inc(st, VariableCode::PARAM, SIR::from(static_cast<SP>(ip->arg)), ip->arg2);
+    NEXT();
+insn_nop:
+    st->state = ScriptEndState::END;
+    goto done;
+
+#undef NEXT
+#undef DISPATCH
+
+bad_pos:
+    if (battle_config.error_log)
+        PRINTF("run_script: not an instruction @ %zu\n"_fmt,
+                st->scriptp.pos);
+    st->state = ScriptEndState::END;
+    goto done;
+slice_over:
+    if (slice && !yield_due)
+    {
+        // finish the current statement under the normal guard
+        yield_due = true;
+        cmdspent = cmdlimit;
+        cmdlimit = script_config.check_cmdcount;
+        cmdcount = cmdlimit;
+        goto *dispatch[static_cast<uint8_t>(ip->op)];
     }
+    PRINTF("run_script: infinity loop !\n"_fmt);
+    st->state = ScriptEndState::END;
+done:
     switch (st->state)
     {
         case ScriptEndState::STOP:
@@ -816,15 +942,23 @@ void run_script_main(ScriptState *st, Borrowed<const ScriptBuffer> rootscript)
         case ScriptEndState::RERUNLINE:
             st->scriptp.pos = rerun_pos;
             break;
+        case ScriptEndState::YIELD:
+            break;
     }
 
-    if (st->state != ScriptEndState::END)
+    if (profile)
+        script_profile_run(profile_code, profile_pos,
+                cmdspent + cmdlimit - cmdcount,
+                st->state != ScriptEndState::END,
+                std::chrono::steady_clock::now() - profile_start);
+
+    if (st->state != ScriptEndState::END && st->state != ScriptEndState::YIELD)
     {
         // 再開するためにスタック情報を保存
         dumb_ptr<map_session_data> sd = map_id2sd(st->rid);
         if (sd)
         {
-            sd->npc_stackbuf = stack->stack_datav;
+            sd->npc_stackbuf.swap(stack->stack_datav);
             sd->npc_script = st->scriptp.code;
             // sd->npc_pos is set later ... ???
             sd->npc_scriptroot = Some(rootscript);
@@ -844,7 +978,6 @@ int run_script(ScriptPointer sp, BlockId rid, BlockId oid)
 int run_script_l(ScriptPointer sp, BlockId rid, BlockId oid,
         Slice<argrec_t> args)
 {
-    struct script_stack stack;
     ScriptState st;
     dumb_ptr<map_session_data> sd = map_id2sd(rid);
     P<const ScriptBuffer> rootscript = TRY_UNWRAP(sp.code, return -1);
@@ -852,16 +985,26 @@ int run_script_l(ScriptPointer sp, BlockId rid, BlockId oid,
     if (sp.pos >> 24)
         return -1;
 
+    std::unique_ptr<script_stack> stack = script_stack_get();
+
     if (sd && !sd->npc_stackbuf.empty() && sd->npc_scriptroot == Some(rootscript))
     {
         // 前回のスタックを復帰
         sp.code = sd->npc_script;
-        stack.stack_datav = std::move(sd->npc_stackbuf);
+        stack->stack_datav.swap(sd->npc_stackbuf);
     }
-    st.stack = &stack;
+    st.stack = stack.get();
     st.scriptp = sp;
     st.rid = rid;
     st.oid = oid;
+    st.detached = !rid;
+    // Only NPC scripts whose player, if any, is held by this NPC can wait
+    // a tick; equipment, item and spell scripts must finish at once.
+    // Floating NPCs are not in the id db at all.
+    dumb_ptr<block_list> obj = map_id2bl(oid);
+    st.can_yield = battle_config.script_slice > 0 && oid
+        && (!obj || obj->bl_type == BL::NPC)
+        && (!sd || sd->npc_id == oid);
     for (i = 0; i < args.size(); i++)
     {
         if (args[i].name.back() == '$')
@@ -871,10 +1014,67 @@ int run_script_l(ScriptPointer sp, BlockId rid, BlockId oid,
     }
     run_script_main(&st, rootscript);
 
-    stack.stack_datav.clear();
+    if (st.state == ScriptEndState::YIELD)
+    {
+        script_slice_push(std::move(stack), &st, rootscript);
+        return -1;
+    }
+    script_stack_put(std::move(stack));
     return st.scriptp.pos;
 }
 
+/*==========================================
+ * 中断したスクリプトの再開
+ * A script attached to a player who has left is dropped, just like a
+ * dialog that was waiting for them; script_slice_drop() does the same
+ * when the player quits or the NPC is freed.  A script that started
+ * without a player is never suspended while it has one.
+ *------------------------------------------
+ */
+static
+void script_slice_resume(TimerData *, tick_t)
+{
+    std::vector<ScriptContinuation> batch;
+    batch.swap(script_continuations);
+    for (ScriptContinuation& c : batch)
+    {
+        dumb_ptr<map_session_data> sd = map_id2sd(c.rid);
+        if (c.rid && !sd)
+        {
+            script_stack_put(std::move(c.stack));
+            continue;
+        }
+
+        ScriptState st;
+        st.stack = c.stack.get();
+        st.scriptp = c.scriptp;
+        st.rid = c.rid;
+        st.oid = c.oid;
+        st.can_yield = true;
+        st.detached = c.detached;
+        run_script_main(&st, c.rootscript);
+
+        if (st.state == ScriptEndState::YIELD)
+        {
+            script_slice_push(std::move(c.stack), &st, c.rootscript);
+            continue;
+        }
+        // what npc_scriptcont would have stored
+        if (sd && sd->npc_id == c.oid)
+            sd->npc_pos = st.scriptp.pos;
+        script_stack_put(std::move(c.stack));
+    }
+}
+
+void script_slice_drop(BlockId id)
+{
+    auto it = std::remove_if(script_continuations.begin(), script_continuations.end(),
+            [id](const ScriptContinuation& c) { return c.rid == id || c.oid == id; });
+    for (auto i = it; i != script_continuations.end(); ++i)
+        script_stack_put(std::move(i->stack));
+    script_continuations.erase(it, script_continuations.end());
+}
+
 void set_script_var_i(dumb_ptr<map_session_data> sd, VarName var, int e, int val)
 {
     size_t k = variable_names.intern(var);
@@ -31,9 +31,6 @@
 
 namespace tmwa
 {
-enum class ByteCode : uint8_t;
-
-// implemented in script-parse.cpp because reasons
 struct ScriptPointer
 {
     Option<Borrowed<const ScriptBuffer>> code;
@@ -47,14 +44,13 @@ struct ScriptPointer
     : code(Some(c))
     , pos(p)
     {}
-
-    ByteCode peek() const;
-    ByteCode pop();
-    ZString pops();
 };
 
 int run_script_l(ScriptPointer, BlockId, BlockId, Slice<argrec_t> args);
 int run_script(ScriptPointer, BlockId, BlockId);
+/// Forget the suspended scripts run by an NPC or attached to a player
+/// that is going away.
+void script_slice_drop(BlockId id);
 
 void set_script_var_i(dumb_ptr<map_session_data> sd, VarName var, int e, int val);
 void set_script_var_s(dumb_ptr<map_session_data> sd, VarName var, int e, XString val);
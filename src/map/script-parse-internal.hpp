@@ -23,6 +23,8 @@
 #include "script-parse.hpp"
 #include "fwd.hpp"
 
+#include <utility>
+
 #include "../strings/rstring.hpp"
 
 
@@ -48,6 +50,20 @@ enum class ByteCode : uint8_t
     // additions
     // needed because FUNC is used for the actual call
     FUNC_REF,
+
+    // made by the optimizer, never in the byte stream:
+    // set x, x + arg2 (arg is the VARIABLE or PARAM operand)
+    INC_VARIABLE, INC_PARAM,
+};
+
+// One instruction, decoded at load time.  For STR, arg is the index
+// of the string in script_const_str(); pos and next are the byte offsets of this
+// instruction and the next one.
+struct ScriptCode
+{
+    ByteCode op;
+    int arg, arg2;
+    size_t pos, next;
 };
 
 struct str_data_t
@@ -64,6 +80,31 @@ Map<RString, str_data_t> str_datam;
 extern
 InternPool variable_names;
 
+// Where a variable lives, decided by its sigils: @tmp, $mapreg, #acc,
+// ##acc2, and plain names saved with the character.  A trailing $ makes
+// it a string variable.
+enum class VariableScope : uint8_t
+{
+    TEMP,
+    MAPREG,
+    ACCOUNT,
+    ACCOUNT2,
+    GLOBAL,
+};
+struct VariableKind
+{
+    VariableScope scope;
+    bool str;
+};
+
+VariableKind variable_kind(size_t var);
+
 Option<Borrowed<str_data_t>> search_strp(XString p);
 Borrowed<str_data_t> add_strp(XString p);
+
+const ScriptCode *script_decoded_at(Borrowed<const ScriptBuffer> code, size_t pos);
+const RString& script_const_str(Borrowed<const ScriptBuffer> code, size_t i);
+RString script_debug_name(Borrowed<const ScriptBuffer> code);
+// the last label at or before pos, with its position
+std::pair<ScriptLabel, size_t> script_label_at(Borrowed<const ScriptBuffer> code, size_t pos);
 } // namespace tmwa
@@ -22,6 +22,8 @@
 //    You should have received a copy of the GNU General Public License
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <algorithm>
+#include <climits>
 #include <set>
 
 #include "../generic/array.hpp"
@@ -36,10 +38,12 @@
 
 #include "../ast/script.hpp"
 
+#include "battle.hpp"
 #include "map.t.hpp"
 #include "script-buffer.hpp"
 #include "script-call.hpp"
 #include "script-fun.hpp"
+#include "script-profile.hpp"
 
 #include "../poison.hpp"
 
@@ -55,6 +59,11 @@ class ScriptBuffer
     std::vector<ByteCode> script_buf;
     RString debug_name;
     std::vector<std::pair<ScriptLabel, size_t>> debug_labels;
+    // script_buf decoded once, and the byte offset -> index map (-1 = none)
+    std::vector<ScriptCode> decoded;
+    std::vector<int> decoded_index;
+    // string literals, built once so STR only has to share them
+    std::vector<RString> const_strs;
 public:
     ScriptBuffer(RString name) : debug_name(std::move(name)) {}
 
@@ -69,6 +78,9 @@ public:
     ZSit parse_expr(ZSit p);
     ZSit parse_line(ZSit p, bool *canstep);
     void parse_script(ZString src, int line, bool implicit_end);
+    void decode_script();
+    void optimize_script();
+    void relink(const std::vector<size_t>& starts);
 
     // consumption methods
     ByteCode operator[](size_t i) const { return script_buf[i]; }
@@ -76,25 +88,49 @@ public:
     {
         return ZString(strings::really_construct_from_a_pointer, reinterpret_cast<const char *>(&script_buf[i]), nullptr);
     }
+    RString name() const { return debug_name; }
+    std::pair<ScriptLabel, size_t> label_at(size_t i) const
+    {
+        auto it = std::upper_bound(debug_labels.begin(), debug_labels.end(), i,
+                [](size_t p, const std::pair<ScriptLabel, size_t>& l) { return p < l.second; });
+        if (it == debug_labels.begin())
+            return {ScriptLabel(), 0};
+        return *--it;
+    }
+    const RString& const_str(size_t i) const { return const_strs[i]; }
+    const ScriptCode *decoded_at(size_t i) const
+    {
+        if (i >= decoded_index.size() || decoded_index[i] < 0)
+            return nullptr;
+        return &decoded[decoded_index[i]];
+    }
 };
 } // namespace tmwa
 
 void std::default_delete<const tmwa::ScriptBuffer>::operator()(const tmwa::ScriptBuffer *sd)
 {
+    tmwa::script_profile_forget(sd);
     really_delete1 sd;
 }
 
 namespace tmwa
 {
-// implemented for script-call.hpp because reasons
-ByteCode ScriptPointer::peek() const { return (*TRY_UNWRAP(code, abort()))[pos]; }
-ByteCode ScriptPointer::pop() { return (*TRY_UNWRAP(code, abort()))[pos++]; }
-ZString ScriptPointer::pops()
+// implemented for script-call.cpp because reasons
+const ScriptCode *script_decoded_at(Borrowed<const ScriptBuffer> code, size_t pos)
+{
+    return code->decoded_at(pos);
+}
+const RString& script_const_str(Borrowed<const ScriptBuffer> code, size_t i)
+{
+    return code->const_str(i);
+}
+RString script_debug_name(Borrowed<const ScriptBuffer> code)
+{
+    return code->name();
+}
+std::pair<ScriptLabel, size_t> script_label_at(Borrowed<const ScriptBuffer> code, size_t pos)
 {
-    ZString rv = TRY_UNWRAP(code, abort())->get_str(pos);
-    pos += rv.size();
-    ++pos;
-    return rv;
+    return code->label_at(pos);
 }
 
 Map<RString, str_data_t> str_datam;
@@ -125,6 +161,34 @@ static
 Option<Borrowed<str_data_t>> parse_cmdp = None;
 
 InternPool variable_names;
+// indexed by the interned name, filled in as names are interned
+static
+std::vector<VariableKind> variable_kinds;
+
+static
+VariableKind classify_variable(XString name)
+{
+    VariableKind kind;
+    kind.str = name.back() == '$';
+    if (name.startswith("##"_s))
+        kind.scope = VariableScope::ACCOUNT2;
+    else if (name.startswith('#'))
+        kind.scope = VariableScope::ACCOUNT;
+    else if (name.startswith('$'))
+        kind.scope = VariableScope::MAPREG;
+    else if (name.startswith('@'))
+        kind.scope = VariableScope::TEMP;
+    else
+        kind.scope = VariableScope::GLOBAL;
+    return kind;
+}
+
+VariableKind variable_kind(size_t var)
+{
+    while (variable_kinds.size() <= var)
+        variable_kinds.push_back(classify_variable(variable_names.outtern(variable_kinds.size())));
+    return variable_kinds[var];
+}
 
 Option<Borrowed<str_data_t>> search_strp(XString p)
 {
@@ -312,6 +376,7 @@ static
 int startline;
 
 int script_errors = 0;
+Script_Optimize_Stats script_optimize_stats;
 /*==========================================
  * エラーメッセージ出力
  *------------------------------------------
@@ -713,6 +778,8 @@ std::unique_ptr<const ScriptBuffer> compile_script(RString debug_name, const ast
 {
     auto script_buf = make_unique<ScriptBuffer>(std::move(debug_name));
     script_buf->parse_script(body.braced_body, body.span.begin.line, implicit_end);
+    if (battle_config.script_optimize)
+        script_buf->optimize_script();
     return std::move(script_buf);
 }
 
@@ -819,6 +886,8 @@ void ScriptBuffer::parse_script(ZString src, int line, bool implicit_end)
             sit.type = StringCode::VARIABLE;
             sit.label_ = 0; // anything but -1. Shouldn't matter, but helps asserts.
             size_t pool_index = variable_names.intern(sit.strs);
+            // resolve the scope now, not on every access
+            variable_kind(pool_index);
             for (int next, j = sit.backpatch; j >= 0 && j != 0x00ffffff; j = next)
             {
                 next = 0;
@@ -849,6 +918,8 @@ void ScriptBuffer::parse_script(ZString src, int line, bool implicit_end)
     }
     probable_labels.clear();
 
+    decode_script();
+
     if (!DEBUG_DISP)
         return;
     for (size_t i = 0; i < script_buf.size(); i++)
@@ -861,4 +932,455 @@ void ScriptBuffer::parse_script(ZString src, int line, bool implicit_end)
     }
     PRINTF("\n"_fmt);
 }
+
+/*==========================================
+ * 実行用に命令列をデコードする
+ * Every instruction is decoded once here, so the interpreter never
+ * has to look at the byte stream.  Positions (labels, callsub return
+ * addresses, npc_pos) keep using byte offsets; decoded_at() maps
+ * them back to an instruction.
+ *------------------------------------------
+ */
+void ScriptBuffer::decode_script()
+{
+    decoded.clear();
+    decoded_index.assign(script_buf.size(), -1);
+    const_strs.clear();
+
+    size_t i = 0;
+    while (i < script_buf.size())
+    {
+        decoded_index[i] = decoded.size();
+        ScriptCode sc {};
+        sc.pos = i;
+        if (static_cast<uint8_t>(script_buf[i]) >= 0x80)
+        {
+            // INT is synthetic: a varint, 6 bits per byte
+            sc.op = ByteCode::INT;
+            int j = 0;
+            uint8_t val;
+            do
+            {
+                val = static_cast<uint8_t>(script_buf[i++]);
+                sc.arg += (val & 0x7f) << j;
+                j += 6;
+            }
+            while (val >= 0xc0);
+        }
+        else
+        {
+            sc.op = script_buf[i++];
+            switch (sc.op)
+            {
+            case ByteCode::POS:
+            case ByteCode::VARIABLE:
+            case ByteCode::FUNC_REF:
+            case ByteCode::PARAM:
+                sc.arg |= static_cast<uint8_t>(script_buf[i + 0]) << 0;
+                sc.arg |= static_cast<uint8_t>(script_buf[i + 1]) << 8;
+                sc.arg |= static_cast<uint8_t>(script_buf[i + 2]) << 16;
+                i += 3;
+                break;
+            case ByteCode::STR:
+                sc.arg = const_strs.size();
+                const_strs.push_back(get_str(i));
+                i += const_strs.back().size() + 1;
+                break;
+            case ByteCode::INT:
+                abort();
+            default:
+                if (sc.op > ByteCode::FUNC_REF)
+                {
+                    PRINTF("%s: unknown command : %d @ %zu\n"_fmt,
+                            debug_name, sc.op, i - 1);
+                    sc.op = ByteCode::NOP;
+                }
+                break;
+            }
+        }
+        sc.next = i;
+        decoded.push_back(sc);
+    }
+}
+
+static
+bool is_binary(ByteCode op)
+{
+    return (ByteCode::LOR <= op && op <= ByteCode::MOD)
+        || op == ByteCode::R_SHIFT || op == ByteCode::L_SHIFT;
+}
+
+static
+bool is_unary(ByteCode op)
+{
+    return op == ByteCode::NEG || op == ByteCode::LNOT || op == ByteCode::NOT;
+}
+
+/*==========================================
+ * 定数の二項演算
+ * Same results as op_add/op_2num; anything those would get wrong
+ * (division by zero, overflow, odd shifts) is left for run time.
+ *------------------------------------------
+ */
+static
+bool fold_binary(ByteCode op, int i1, int i2, int *out)
+{
+    int64_t a = i1, b = i2, r;
+    switch (op)
+    {
+        case ByteCode::ADD: r = a + b; break;
+        case ByteCode::SUB: r = a - b; break;
+        case ByteCode::MUL: r = a * b; break;
+        case ByteCode::DIV:
+        case ByteCode::MOD:
+            if (b == 0 || (a == INT_MIN && b == -1))
+                return false;
+            r = op == ByteCode::DIV ? a / b : a % b;
+            break;
+        case ByteCode::AND: r = i1 & i2; break;
+        case ByteCode::OR: r = i1 | i2; break;
+        case ByteCode::XOR: r = i1 ^ i2; break;
+        case ByteCode::LAND: r = i1 && i2; break;
+        case ByteCode::LOR: r = i1 || i2; break;
+        case ByteCode::EQ: r = i1 == i2; break;
+        case ByteCode::NE: r = i1 != i2; break;
+        case ByteCode::GT: r = i1 > i2; break;
+        case ByteCode::GE: r = i1 >= i2; break;
+        case ByteCode::LT: r = i1 < i2; break;
+        case ByteCode::LE: r = i1 <= i2; break;
+        case ByteCode::R_SHIFT:
+            if (b < 0 || b > 31)
+                return false;
+            r = i1 >> i2;
+            break;
+        case ByteCode::L_SHIFT:
+            if (b < 0 || b > 31 || a < 0)
+                return false;
+            r = a << b;
+            break;
+        default:
+            return false;
+    }
+    if (r < INT_MIN || r > INT_MAX)
+        return false;
+    *out = r;
+    return true;
+}
+
+static
+bool fold_unary(ByteCode op, int i1, int *out)
+{
+    switch (op)
+    {
+        case ByteCode::NEG:
+            if (i1 == INT_MIN)
+                return false;
+            *out = -i1;
+            return true;
+        case ByteCode::NOT:
+            *out = ~i1;
+            return true;
+        case ByteCode::LNOT:
+            *out = !i1;
+            return true;
+        default:
+            return false;
+    }
+}
+
+/*==========================================
+ * v[b, e) がちょうど一つの関数呼び出しか
+ * FUNC_REF f, ARG, args..., FUNC, with every operator having its
+ * operands and the last FUNC closing the first FUNC_REF.
+ *------------------------------------------
+ */
+static
+bool is_single_call(const std::vector<ScriptCode>& v, size_t b, size_t e)
+{
+    if (e - b < 3 || v[b].op != ByteCode::FUNC_REF
+            || v[b + 1].op != ByteCode::ARG || v[e - 1].op != ByteCode::FUNC)
+        return false;
+
+    // what is on the stack at run time: 'v'alue, 'a'rg marker, 'f'unc ref
+    std::vector<char> stack;
+    for (size_t i = b; i < e; i++)
+    {
+        ByteCode op = v[i].op;
+        switch (op)
+        {
+            case ByteCode::FUNC_REF:
+                stack.push_back('f');
+                break;
+            case ByteCode::ARG:
+                if (stack.empty() || stack.back() != 'f')
+                    return false;
+                stack.push_back('a');
+                break;
+            case ByteCode::FUNC:
+                while (!stack.empty() && stack.back() != 'a')
+                    stack.pop_back();
+                if (stack.size() < 2)
+                    return false;
+                stack.pop_back();
+                stack.pop_back();
+                if (i + 1 == e)
+                    return stack.empty();
+                stack.push_back('v');
+                break;
+            case ByteCode::INT:
+            case ByteCode::POS:
+            case ByteCode::STR:
+            case ByteCode::VARIABLE:
+            case ByteCode::PARAM:
+                stack.push_back('v');
+                break;
+            default:
+                if (is_binary(op))
+                {
+                    if (stack.size() < 2 || stack.back() != 'v' || stack[stack.size() - 2] != 'v')
+                        return false;
+                    stack.pop_back();
+                }
+                else if (is_unary(op))
+                {
+                    if (stack.empty() || stack.back() != 'v')
+                        return false;
+                }
+                else
+                    return false;
+                break;
+        }
+    }
+    return false;
+}
+
+static
+bool is_call_to(const std::vector<ScriptCode>& v, size_t b, size_t e, int func)
+{
+    return func >= 0 && e - b >= 3 && v[b].arg == func && is_single_call(v, b, e);
+}
+
+static
+int builtin_index(XString name)
+{
+    Borrowed<str_data_t> data = TRY_UNWRAP(search_strp(name), return -1);
+    if (data->type != StringCode::FUNC)
+        return -1;
+    return data->val;
+}
+
+/*==========================================
+ * 最適化後に next と decoded_index を作り直す
+ * starts holds every original instruction offset; each one now
+ * means the first surviving instruction at or after it.
+ *------------------------------------------
+ */
+void ScriptBuffer::relink(const std::vector<size_t>& starts)
+{
+    for (size_t k = 0; k + 1 < decoded.size(); k++)
+        decoded[k].next = decoded[k + 1].pos;
+    if (!decoded.empty())
+        decoded.back().next = script_buf.size();
+
+    decoded_index.assign(script_buf.size(), -1);
+    size_t k = 0;
+    for (size_t p : starts)
+    {
+        while (k < decoded.size() && decoded[k].pos < p)
+            k++;
+        if (k < decoded.size())
+            decoded_index[p] = k;
+    }
+}
+
+/*==========================================
+ * デコード済み命令列の最適化
+ * Works one statement at a time on the decoded form only; the byte
+ * stream and every byte offset (labels, callsub returns, npc_pos)
+ * stay valid.  Folds operators on constants, resolves if with a
+ * constant condition, fuses set x, x +/- constant, threads goto
+ * chains and drops statements that nothing can reach.
+ *------------------------------------------
+ */
+void ScriptBuffer::optimize_script()
+{
+    const int f_if = builtin_index("if"_s);
+    const int f_set = builtin_index("set"_s);
+    const int f_goto = builtin_index("goto"_s);
+    const int f_end = builtin_index("end"_s);
+    const int f_return = builtin_index("return"_s);
+    const int f_close = builtin_index("close"_s);
+
+    Script_Optimize_Stats& stats = script_optimize_stats;
+    stats.scripts++;
+    stats.insns_before += decoded.size();
+
+    std::vector<size_t> starts;
+    starts.reserve(decoded.size());
+    for (const ScriptCode& sc : decoded)
+        starts.push_back(sc.pos);
+
+    std::vector<ScriptCode> out;
+    out.reserve(decoded.size());
+    std::vector<ScriptCode> st;
+    size_t i = 0;
+    while (i < decoded.size())
+    {
+        // one statement, without its EOL
+        st.clear();
+        for (; i < decoded.size() && decoded[i].op != ByteCode::EOL; i++)
+        {
+            const ScriptCode& sc = decoded[i];
+            size_t n = st.size();
+            int val;
+            if (is_binary(sc.op) && n >= 2
+                    && st[n - 2].op == ByteCode::INT && st[n - 1].op == ByteCode::INT
+                    && fold_binary(sc.op, st[n - 2].arg, st[n - 1].arg, &val))
+            {
+                st.pop_back();
+                st.back().arg = val;
+                stats.folded++;
+                continue;
+            }
+            if (is_unary(sc.op) && n >= 1
+                    && st[n - 1].op == ByteCode::INT
+                    && fold_unary(sc.op, st[n - 1].arg, &val))
+            {
+                st.back().arg = val;
+                stats.folded++;
+                continue;
+            }
+            st.push_back(sc);
+        }
+
+        // if (constant) cmd args...;
+        // a bare FUNC_REF right after the condition is the command
+        if (st.size() >= 5 && st[2].op == ByteCode::INT
+                && st[3].op == ByteCode::FUNC_REF && st[4].op != ByteCode::ARG
+                && is_call_to(st, 0, st.size(), f_if))
+        {
+            if (!st[2].arg)
+            {
+                st.clear();
+                stats.branches++;
+            }
+            else
+            {
+                std::vector<ScriptCode> cmd;
+                cmd.push_back(st[3]);
+                cmd.back().pos = st[0].pos;
+                cmd.push_back(st[1]);
+                cmd.insert(cmd.end(), st.begin() + 4, st.end());
+                if (is_single_call(cmd, 0, cmd.size()))
+                {
+                    st = std::move(cmd);
+                    stats.branches++;
+                }
+            }
+        }
+
+        // set x, x + k;  set x, x - k;
+        if (st.size() == 7 && st[2].op == st[3].op && st[2].arg == st[3].arg
+                && st[4].op == ByteCode::INT
+                && (st[5].op == ByteCode::ADD || st[5].op == ByteCode::SUB)
+                && is_call_to(st, 0, st.size(), f_set)
+                && ((st[2].op == ByteCode::VARIABLE
+                        && !variable_kind(st[2].arg).str)
+                    || st[2].op == ByteCode::PARAM)
+                && !(st[5].op == ByteCode::SUB && st[4].arg == INT_MIN))
+        {
+            ScriptCode inc {};
+            inc.op = st[2].op == ByteCode::VARIABLE
+                ? ByteCode::INC_VARIABLE : ByteCode::INC_PARAM;
+            inc.arg = st[2].arg;
+            inc.arg2 = st[5].op == ByteCode::ADD ? st[4].arg : -st[4].arg;
+            inc.pos = st[0].pos;
+            st.assign(1, inc);
+            stats.increments++;
+        }
+
+        out.insert(out.end(), st.begin(), st.end());
+        if (i < decoded.size())
+            out.push_back(decoded[i++]);
+    }
+    decoded = std::move(out);
+    relink(starts);
+
+    // goto L; where L: goto M;
+    // only the operand of goto itself, as a command or inside an if
+    for (size_t j = 0; j < decoded.size(); j++)
+    {
+        if (decoded[j].op != ByteCode::POS || f_goto < 0)
+            continue;
+        bool jump = (j >= 1 && decoded[j - 1].op == ByteCode::FUNC_REF && decoded[j - 1].arg == f_goto)
+            || (j >= 2 && decoded[j - 2].op == ByteCode::FUNC_REF && decoded[j - 2].arg == f_goto
+                && decoded[j - 1].op == ByteCode::ARG);
+        if (!jump)
+            continue;
+        int target = decoded[j].arg;
+        for (int hops = 0; hops < 16; hops++)
+        {
+            if (target < 0 || target >= static_cast<int>(decoded_index.size())
+                    || decoded_index[target] < 0)
+                break;
+            size_t t = decoded_index[target];
+            if (t + 4 >= decoded.size() || decoded[t + 4].op != ByteCode::EOL
+                    || decoded[t + 2].op != ByteCode::POS
+                    || !is_call_to(decoded, t, t + 4, f_goto))
+                break;
+            if (decoded[t + 2].arg == target)
+                break;
+            target = decoded[t + 2].arg;
+        }
+        if (target != decoded[j].arg)
+        {
+            decoded[j].arg = target;
+            stats.threaded++;
+        }
+    }
+
+    // anything after goto/end/return/close up to the next place
+    // a jump, label or event can land
+    std::vector<bool> is_target(decoded.size());
+    auto mark = [&](size_t p)
+    {
+        if (p < decoded_index.size() && decoded_index[p] >= 0)
+            is_target[decoded_index[p]] = true;
+    };
+    mark(0);
+    for (const auto& label : debug_labels)
+        mark(label.second);
+    for (const ScriptCode& sc : decoded)
+        if (sc.op == ByteCode::POS)
+            mark(sc.arg);
+
+    out.clear();
+    bool live = true;
+    size_t s = 0;
+    while (s < decoded.size())
+    {
+        size_t e = s;
+        while (e < decoded.size() && decoded[e].op != ByteCode::EOL)
+            e++;
+        size_t end = e < decoded.size() ? e + 1 : e;
+
+        if (std::find(is_target.begin() + s, is_target.begin() + end, true) != is_target.begin() + end)
+            live = true;
+        // the final NOP stays no matter what
+        if (live || end == decoded.size())
+            out.insert(out.end(), decoded.begin() + s, decoded.begin() + end);
+        else
+            stats.dead++;
+        if (live && (is_call_to(decoded, s, e, f_goto)
+                    || is_call_to(decoded, s, e, f_end)
+                    || is_call_to(decoded, s, e, f_return)
+                    || is_call_to(decoded, s, e, f_close)))
+            live = false;
+        s = end;
+    }
+    decoded = std::move(out);
+    relink(starts);
+
+    stats.insns_after += decoded.size();
+}
 } // namespace tmwa
@@ -37,4 +37,21 @@ extern
 UPMap<RString, const ScriptBuffer> userfunc_db;
 
 extern int script_errors;
+
+/// Counters for battle_config.script_optimize, printed after the NPCs load.
+extern struct Script_Optimize_Stats
+{
+    long scripts;
+    long insns_before, insns_after;
+    // operators on constants evaluated at load time
+    long folded;
+    // if with a constant condition, replaced by its command or dropped
+    long branches;
+    // set x, x +/- constant
+    long increments;
+    // goto whose target was another goto
+    long threaded;
+    // unreachable statements removed
+    long dead;
+} script_optimize_stats;
 } // namespace tmwa
@@ -0,0 +1,249 @@
+#include "script-profile.hpp"
+//    script-profile.cpp - Counters for time spent in NPC scripts.
+//
+//    Copyright © 2026 The Mana World Development Team
+//
+//    This file is part of The Mana World (Athena server)
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+#include "../strings/rstring.hpp"
+#include "../strings/literal.hpp"
+
+#include "../io/cxxstdio.hpp"
+#include "../io/lock.hpp"
+
+#include "../net/timer.hpp"
+
+#include "../mmo/strs.hpp"
+
+#include "battle.hpp"
+#include "script-fun.hpp"
+#include "script-parse-internal.hpp"
+
+#include "../poison.hpp"
+
+
+namespace tmwa
+{
+AString script_profile_txt = "log/script_profile.tsv"_s;
+constexpr std::chrono::milliseconds SCRIPT_PROFILE_DUMP_INTERVAL = 60_s;
+
+// bucket i counts runs of 2^i to 2^(i+1) microseconds; bucket 0 is under 2
+constexpr int SCRIPT_PROFILE_BUCKETS = 24;
+
+struct ScriptProfileEntry
+{
+    AString name;
+    long runs = 0, pauses = 0;
+    long insns = 0;
+    std::chrono::nanoseconds total = 0_ns, longest = 0_ns;
+};
+
+struct BuiltinProfileEntry
+{
+    long calls = 0;
+    std::chrono::nanoseconds total = 0_ns;
+};
+
+// keyed by script and the position of the label the run started under
+static
+std::map<std::pair<const ScriptBuffer *, size_t>, ScriptProfileEntry> script_profile_db;
+// indexed like builtin_functions[]
+static
+std::vector<BuiltinProfileEntry> builtin_profile_db;
+static
+long script_profile_histogram[SCRIPT_PROFILE_BUCKETS];
+static
+tick_t script_profile_since;
+// scripts freed after this are not looked up; see do_final_script_profile
+static
+bool script_profile_done = false;
+
+static
+double as_ms(std::chrono::nanoseconds d)
+{
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+void script_profile_run(Borrowed<const ScriptBuffer> code, size_t pos,
+        int insns, bool paused, std::chrono::nanoseconds elapsed)
+{
+    std::pair<ScriptLabel, size_t> label = script_label_at(code, pos);
+    ScriptProfileEntry& e = script_profile_db[{&*code, label.second}];
+    if (!e.name)
+    {
+        if (label.first)
+            e.name = STRPRINTF("%s::%s"_fmt, script_debug_name(code), label.first);
+        else
+            e.name = script_debug_name(code);
+    }
+    e.runs++;
+    if (paused)
+        e.pauses++;
+    e.insns += insns;
+    e.total += elapsed;
+    e.longest = std::max(e.longest, elapsed);
+
+    long us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    int bucket = 0;
+    while (us > 1 && bucket < SCRIPT_PROFILE_BUCKETS - 1)
+    {
+        us >>= 1;
+        bucket++;
+    }
+    script_profile_histogram[bucket]++;
+}
+
+void script_profile_builtin(size_t func, std::chrono::nanoseconds elapsed)
+{
+    if (func >= builtin_profile_db.size())
+        builtin_profile_db.resize(func + 1);
+    builtin_profile_db[func].calls++;
+    builtin_profile_db[func].total += elapsed;
+}
+
+void script_profile_forget(const ScriptBuffer *code)
+{
+    if (script_profile_done)
+        return;
+    auto it = script_profile_db.lower_bound({code, 0});
+    while (it != script_profile_db.end() && it->first.first == code)
+        it = script_profile_db.erase(it);
+}
+
+void script_profile_reset(void)
+{
+    script_profile_db.clear();
+    builtin_profile_db.clear();
+    std::fill(std::begin(script_profile_histogram), std::end(script_profile_histogram), 0);
+    script_profile_since = gettick();
+}
+
+std::vector<AString> script_profile_report(size_t count)
+{
+    std::vector<AString> out;
+
+    std::vector<const ScriptProfileEntry *> runs;
+    long total_runs = 0, total_insns = 0;
+    for (const auto& pair : script_profile_db)
+    {
+        runs.push_back(&pair.second);
+        total_runs += pair.second.runs;
+        total_insns += pair.second.insns;
+    }
+    std::sort(runs.begin(), runs.end(),
+            [](const ScriptProfileEntry *l, const ScriptProfileEntry *r)
+            {
+                return l->total > r->total;
+            });
+    if (runs.size() > count)
+        runs.resize(count);
+
+    std::vector<size_t> funcs;
+    for (size_t i = 0; i < builtin_profile_db.size(); i++)
+        if (builtin_profile_db[i].calls)
+            funcs.push_back(i);
+    std::sort(funcs.begin(), funcs.end(),
+            [](size_t l, size_t r)
+            {
+                return builtin_profile_db[l].total > builtin_profile_db[r].total;
+            });
+    if (funcs.size() > count)
+        funcs.resize(count);
+
+    out.push_back(STRPRINTF("Script profiling is %s; %ld runs, %ld instructions in %ld s."_fmt,
+                battle_config.script_profile ? "on"_s : "off"_s,
+                total_runs, total_insns,
+                std::chrono::duration_cast<std::chrono::seconds>(gettick() - script_profile_since).count()));
+    for (const ScriptProfileEntry *e : runs)
+        out.push_back(STRPRINTF("%s: %ld runs, %ld paused, %ld insns, %.3f ms, longest %.3f ms"_fmt,
+                    e->name, e->runs, e->pauses, e->insns,
+                    as_ms(e->total), as_ms(e->longest)));
+    for (size_t i : funcs)
+        out.push_back(STRPRINTF("builtin %s: %ld calls, %.3f ms"_fmt,
+                    builtin_functions[i].name, builtin_profile_db[i].calls,
+                    as_ms(builtin_profile_db[i].total)));
+    return out;
+}
+
+/*==========================================
+ * 統計をファイルに書き出す
+ * Tab separated, first column is the record type:
+ *   run     name runs paused insns total_us longest_us
+ *   builtin name calls total_us
+ *   hist    min_us count
+ *------------------------------------------
+ */
+void script_profile_dump(void)
+{
+    io::WriteLock fp(script_profile_txt);
+    if (!fp.is_open())
+        return;
+
+    namespace c = std::chrono;
+    for (const auto& pair : script_profile_db)
+    {
+        const ScriptProfileEntry& e = pair.second;
+        FPRINTF(fp, "run\t%s\t%ld\t%ld\t%ld\t%ld\t%ld\n"_fmt,
+                e.name, e.runs, e.pauses, e.insns,
+                c::duration_cast<c::microseconds>(e.total).count(),
+                c::duration_cast<c::microseconds>(e.longest).count());
+    }
+    for (size_t i = 0; i < builtin_profile_db.size(); i++)
+    {
+        const BuiltinProfileEntry& b = builtin_profile_db[i];
+        if (!b.calls)
+            continue;
+        FPRINTF(fp, "builtin\t%s\t%ld\t%ld\n"_fmt,
+                builtin_functions[i].name, b.calls,
+                c::duration_cast<c::microseconds>(b.total).count());
+    }
+    for (int i = 0; i < SCRIPT_PROFILE_BUCKETS; i++)
+    {
+        if (script_profile_histogram[i])
+            FPRINTF(fp, "hist\t%ld\t%ld\n"_fmt,
+                    i ? 1L << i : 0L, script_profile_histogram[i]);
+    }
+}
+
+static
+void script_profile_timer(TimerData *, tick_t)
+{
+    if (battle_config.script_profile)
+        script_profile_dump();
+}
+
+void do_init_script_profile(void)
+{
+    script_profile_since = gettick();
+
+    Timer(gettick() + SCRIPT_PROFILE_DUMP_INTERVAL,
+            script_profile_timer,
+            SCRIPT_PROFILE_DUMP_INTERVAL
+    ).detach();
+}
+
+// Some scripts are only freed by static destructors, which may run
+// after script_profile_db's.
+void do_final_script_profile(void)
+{
+    script_profile_db.clear();
+    script_profile_done = true;
+}
+} // namespace tmwa
@@ -0,0 +1,54 @@
+#pragma once
+//    script-profile.hpp - Counters for time spent in NPC scripts.
+//
+//    Copyright © 2026 The Mana World Development Team
+//
+//    This file is part of The Mana World (Athena server)
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "fwd.hpp"
+
+#include <chrono>
+#include <vector>
+
+#include "../compat/borrow.hpp"
+
+#include "../strings/astring.hpp"
+
+#include "script-buffer.hpp"
+
+
+namespace tmwa
+{
+/// Everything here is only called while battle_config.script_profile
+/// is set; the engine checks the flag itself.
+extern AString script_profile_txt;
+
+/// One call of run_script_main, keyed by the label it started under.
+void script_profile_run(Borrowed<const ScriptBuffer> code, size_t pos,
+        int insns, bool paused, std::chrono::nanoseconds elapsed);
+void script_profile_builtin(size_t func, std::chrono::nanoseconds elapsed);
+/// Called when a script is freed, so that a new one allocated at the
+/// same address does not inherit its counters.
+void script_profile_forget(const ScriptBuffer *code);
+
+/// Human-readable summary of the top `count` entries, for @scriptprofile.
+std::vector<AString> script_profile_report(size_t count);
+void script_profile_reset(void);
+void script_profile_dump(void);
+
+void do_init_script_profile(void);
+void do_final_script_profile(void);
+} // namespace tmwa
@@ -0,0 +1,77 @@
+#include "script-profile.hpp"
+//    map/script-profile_test.cpp - Testsuite for the script profiler
+//
+//    Copyright © 2026 The Mana World Development Team
+//
+//    This file is part of The Mana World (Athena server)
+//
+//    This program is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    This program is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include "../io/line.hpp"
+
+#include "../ast/script.hpp"
+
+#include "script-parse.hpp"
+
+#include "../poison.hpp"
+
+
+namespace tmwa
+{
+static
+std::unique_ptr<const ScriptBuffer> compile(RString name)
+{
+    io::LineCharReader lr(io::from_string, "<test>"_s, "{\n    end;\n}\n"_s);
+    ast::script::ScriptOptions opt;
+    opt.implicit_start = true;
+    opt.implicit_end = true;
+    opt.no_event = true;
+    auto code_res = ast::script::parse_script_body(lr, opt);
+    auto code = TRY_UNWRAP(code_res.get_success(), return nullptr);
+    return compile_script(name, code, true);
+}
+
+static
+bool reported(ZString name)
+{
+    std::vector<AString> report = script_profile_report(100);
+    return std::any_of(report.begin(), report.end(),
+            [name](const AString& line) { return line.startswith(name); });
+}
+
+TEST(script_profile, forget_on_free)
+{
+    std::unique_ptr<const ScriptBuffer> buf = compile("profiled"_s);
+    ASSERT_TRUE(buf);
+    script_profile_run(borrow(*buf), 0, 1, false, std::chrono::milliseconds(1));
+    EXPECT_TRUE(reported("profiled"_s));
+
+    buf.reset();
+    EXPECT_FALSE(reported("profiled"_s));
+}
+
+TEST(script_profile, forget_after_final)
+{
+    std::unique_ptr<const ScriptBuffer> buf = compile("late"_s);
+    ASSERT_TRUE(buf);
+    script_profile_run(borrow(*buf), 0, 1, false, std::chrono::milliseconds(1));
+    do_final_script_profile();
+    EXPECT_FALSE(reported("late"_s));
+    buf.reset();
+}
+} // namespace tmwa
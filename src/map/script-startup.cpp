@@ -22,6 +22,11 @@
 //    You should have received a copy of the GNU General Public License
 //    along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <unistd.h>
+
+#include <algorithm>
+#include <set>
+
 #include "../strings/zstring.hpp"
 
 #include "../generic/db.hpp"
@@ -31,6 +36,7 @@
 #include "../io/extract.hpp"
 #include "../io/read.hpp"
 #include "../io/lock.hpp"
+#include "../io/write.hpp"
 
 #include "../net/timer.hpp"
 
@@ -49,6 +55,22 @@ int mapreg_dirty = -1;
 AString mapreg_txt = "save/mapreg.txt"_s;
 constexpr std::chrono::milliseconds MAPREG_AUTOSAVE_INTERVAL = 10_s;
 
+// Registers changed since the last autosave.  Each autosave appends
+// their current values to the journal next to mapreg_txt; once the
+// journal holds more records than there are registers (and at least
+// MAPREG_JOURNAL_MIN), the whole set is rewritten and the journal goes.
+static
+std::set<SIR> mapreg_changed, mapregstr_changed;
+static
+int mapreg_journal_records;
+constexpr int MAPREG_JOURNAL_MIN = 1024;
+
+static
+AString mapreg_journal_txt(void)
+{
+    return STRPRINTF("%s.journal"_fmt, mapreg_txt);
+}
+
 bool read_constdb(ZString filename)
 {
     io::ReadFile in(filename);
@@ -108,6 +130,13 @@ bool read_constdb(ZString filename)
     return rv;
 }
 
+// $@ registers are never saved
+static
+bool mapreg_is_temporary(SIR reg)
+{
+    return variable_names.outtern(reg.base())[1] == '@';
+}
+
 /*==========================================
  * マップ変数の変更
  *------------------------------------------
@@ -115,6 +144,9 @@ bool read_constdb(ZString filename)
 void mapreg_setreg(SIR reg, int val)
 {
     mapreg_db.put(reg, val);
+    if (mapreg_is_temporary(reg))
+        return;
+    mapreg_changed.insert(reg);
 
     mapreg_dirty = 1;
 }
@@ -129,25 +161,33 @@ void mapreg_setregstr(SIR reg, XString str)
         mapregstr_db.erase(reg);
     else
         mapregstr_db.insert(reg, str);
+    if (mapreg_is_temporary(reg))
+        return;
+    mapregstr_changed.insert(reg);
 
     mapreg_dirty = 1;
 }
 
 /*==========================================
  * 永続的マップ変数の読み込み
+ * The journal uses the same line format and is replayed on top of
+ * mapreg_txt; an empty string or a 0 removes the register.
+ * Returns the number of lines read.
  *------------------------------------------
  */
 static
-void script_load_mapreg(void)
+int script_load_mapreg_file(ZString filename)
 {
-    io::ReadFile in(mapreg_txt);
+    io::ReadFile in(filename);
 
     if (!in.is_open())
-        return;
+        return 0;
 
+    int lines = 0;
     AString line;
     while (in.getline(line))
     {
+        lines++;
         XString buf1, buf2;
         int index = 0;
         if (extract(line,
@@ -163,7 +203,10 @@ void script_load_mapreg(void)
             SIR key = SIR::from(s, index);
             if (buf1.back() == '$')
             {
-                mapregstr_db.insert(key, buf2);
+                if (buf2)
+                    mapregstr_db.insert(key, buf2);
+                else
+                    mapregstr_db.erase(key);
             }
             else
             {
@@ -176,10 +219,19 @@ void script_load_mapreg(void)
         else
         {
         borken:
-            PRINTF("%s: %s broken data !\n"_fmt, mapreg_txt, AString(buf1));
+            PRINTF("%s: %s broken data !\n"_fmt, filename, AString(buf1));
             continue;
         }
     }
+    return lines;
+}
+
+static
+void script_load_mapreg(void)
+{
+    script_load_mapreg_file(mapreg_txt);
+    // whatever the last run saved after its last full write
+    mapreg_journal_records = script_load_mapreg_file(mapreg_journal_txt());
     mapreg_dirty = 0;
 }
 
@@ -215,24 +267,70 @@ void script_save_mapreg_strsub(SIR key, ZString data, io::WriteFile& fp)
     }
 }
 
+/*==========================================
+ * 変更されたマップ変数だけを追記する
+ *------------------------------------------
+ */
+static
+void script_journal_mapreg(void)
+{
+    {
+        io::AppendFile fp(mapreg_journal_txt());
+        if (!fp.is_open())
+            return;
+        for (SIR key : mapreg_changed)
+            script_save_mapreg_intsub(key, mapreg_db.get(key), fp);
+        for (SIR key : mapregstr_changed)
+        {
+            ZString data = ""_s;
+            Option<P<RString>> s_ = mapregstr_db.search(key);
+            if OPTION_IS_SOME(s, s_)
+                data = *s;
+            script_save_mapreg_strsub(key, data, fp);
+        }
+    }
+    mapreg_journal_records += mapreg_changed.size() + mapregstr_changed.size();
+    mapreg_changed.clear();
+    mapregstr_changed.clear();
+    mapreg_dirty = 0;
+}
+
 static
 void script_save_mapreg(void)
 {
-    io::WriteLock fp(mapreg_txt);
-    if (!fp.is_open())
-        return;
-    for (auto& pair : mapreg_db)
-        script_save_mapreg_intsub(pair.first, pair.second, fp);
-    for (auto& pair : mapregstr_db)
-        script_save_mapreg_strsub(pair.first, pair.second, fp);
+    // Bring the journal up to date first: if the server dies after the
+    // new mapreg_txt is in place but before the journal is removed,
+    // replaying it then only sets the values mapreg_txt already has.
+    if (!mapreg_changed.empty() || !mapregstr_changed.empty())
+        script_journal_mapreg();
+    {
+        io::WriteLock fp(mapreg_txt);
+        if (!fp.is_open())
+            return;
+        for (auto& pair : mapreg_db)
+            script_save_mapreg_intsub(pair.first, pair.second, fp);
+        for (auto& pair : mapregstr_db)
+            script_save_mapreg_strsub(pair.first, pair.second, fp);
+    }
+    // only once the new file is in place
+    unlink(mapreg_journal_txt().c_str());
+    mapreg_journal_records = 0;
+    mapreg_changed.clear();
+    mapregstr_changed.clear();
     mapreg_dirty = 0;
 }
 
 static
 void script_autosave_mapreg(TimerData *, tick_t)
 {
-    if (mapreg_dirty)
+    if (!mapreg_dirty)
+        return;
+    size_t live = mapreg_db.size() + mapregstr_db.size();
+    size_t pending = mapreg_journal_records + mapreg_changed.size() + mapregstr_changed.size();
+    if (pending > std::max<size_t>(live, MAPREG_JOURNAL_MIN))
         script_save_mapreg();
+    else
+        script_journal_mapreg();
 }
 
 void do_final_script(void)
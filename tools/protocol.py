@@ -3556,6 +3556,29 @@ def build_context():
         ],
         fixed_size=6,
     )
+    char_map.r(0x2b17, 'character delta save',
+        head=[
+            at(0, u16, 'packet id'),
+            at(2, u16, 'packet length'),
+            at(4, account_id, 'account id'),
+            at(8, char_id, 'char id'),
+            at(12, char_key, 'char key'),
+            at(45, u64, 'base checksum'),
+        ],
+        head_size=53,
+        repeat=[
+            at(0, u16, 'block'),
+            at(2, u64, 'data'),
+        ],
+        repeat_size=10,
+    )
+    char_map.s(0x2b18, 'character save resync',
+        fixed=[
+            at(0, u16, 'packet id'),
+            at(2, char_id, 'char id'),
+        ],
+        fixed_size=6,
+    )
 
     char_map.r(0x3000, 'gm broadcast',
         head=[